@@ -0,0 +1,178 @@
+/*
+ *  accounting.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+#ifdef __GLIBC__
+    // the allocator of glibc, heapTracker allocates from it directly so that its blocks are not
+    // counted twice when unittests/heaptracking.cpp replaces malloc
+    extern "C" {
+        void* __libc_malloc(size_t size);
+        void __libc_free(void* p);
+    }
+#endif
+
+namespace math {
+    /// <summary>
+    /// memory and compute of one network and its training job (see supervisor::resources).
+    /// Bytes are the exact sizes of the buffers, flops count multiplications and additions;
+    /// transfer functions are counted separately.
+    /// </summary>
+    typedef struct resourceReport {
+        // nn.parameters
+        size_t parameterBytes = 0;
+        // activation buffers of nn (ioutput, houtput, ooutput)
+        size_t activationBytes = 0;
+        // workspace of a training step (activations, deltas and gradient)
+        size_t workspaceBytes = 0;
+        // gradient, part of the workspace
+        size_t gradientBytes = 0;
+        // update mask and adaptive learning rate state of the trainer
+        size_t optimizerBytes = 0;
+        // samples of the dataset including the dataSet objects
+        size_t datasetBytes = 0;
+        // per sample: flops and transfer function evaluations of calculateNN, flops of backpropagation
+        size_t forwardFlops = 0, transfers = 0, backwardFlops = 0;
+
+        /// <summary>
+        /// bytes of a training job (the gradient is part of the workspace)
+        /// </summary>
+        size_t totalBytes() const {
+            return parameterBytes + activationBytes + workspaceBytes + optimizerBytes + datasetBytes;
+        }
+
+        void print(std::ostream& os) const {
+            os << "parameters: " << parameterBytes << " B, activations: " << activationBytes
+               << " B, workspace: " << workspaceBytes << " B (gradient: " << gradientBytes
+               << " B), optimizer: " << optimizerBytes << " B, dataset: " << datasetBytes
+               << " B, total: " << totalBytes() << " B\n"
+               << "per sample: forward " << forwardFlops << " flops + " << transfers
+               << " transfer functions, backward " << backwardFlops << " flops" << std::endl;
+        }
+    } resourceReport;
+
+    /// <summary>
+    /// counts the heap in use and its peak. Counting is only active if the global operator new
+    /// and delete forward to allocate and deallocate: link unittests/heaptracking.cpp into the
+    /// program, or call them from your own replacements. With glibc, heaptracking.cpp also
+    /// replaces malloc and free, so the buffers of Eigen (and of math::vector and math::matrix)
+    /// are counted as well.
+    /// </summary>
+    class heapTracker {
+        public:
+            static void* allocate(size_t size) {
+                // the size is kept in front of the block for deallocate
+                void* p = rawAllocate(size + header);
+                if (!p)
+                    throw std::bad_alloc();
+                *static_cast<size_t*>(p) = size;
+                added(size);
+                return static_cast<char*>(p) + header;
+            }
+
+            static void deallocate(void* p) noexcept {
+                if (!p)
+                    return;
+                void* block = static_cast<char*>(p) - header;
+                removed(*static_cast<size_t*>(block));
+                rawFree(block);
+            }
+
+            /// <summary>
+            /// count a block of size bytes that was allocated, or freed, outside of allocate
+            /// </summary>
+            static void added(size_t size) noexcept {
+                state().allocations.fetch_add(1);
+                const size_t now = state().current.fetch_add(size) + size;
+                size_t peak = state().peak.load();
+                while (now > peak && !state().peak.compare_exchange_weak(peak, now)) {}
+                state().enabled = true;
+            }
+
+            static void removed(size_t size) noexcept {
+                state().current.fetch_sub(size);
+            }
+
+            /// <summary>
+            /// true if allocations are counted
+            /// </summary>
+            static bool enabled() {
+                return state().enabled;
+            }
+
+            /// <summary>
+            /// bytes currently allocated and the largest number of bytes allocated at the same time
+            /// since the last resetPeak
+            /// </summary>
+            static size_t current() {
+                return state().current.load();
+            }
+
+            static size_t peak() {
+                return state().peak.load();
+            }
+
+            /// <summary>
+            /// number of counted allocations since the start of the program
+            /// </summary>
+            static size_t allocations() {
+                return state().allocations.load();
+            }
+
+            static void resetPeak() {
+                state().peak.store(state().current.load());
+            }
+
+            /// <summary>
+            /// run func and return the peak heap above the heap in use when it started
+            /// </summary>
+            template<typename F>
+            static size_t measure(F&& func) {
+                const size_t start = current();
+                resetPeak();
+                func();
+                return peak() - std::min(peak(), start);
+            }
+
+        private:
+            // keeps the returned blocks aligned like malloc
+            static constexpr size_t header = alignof(std::max_align_t);
+
+            typedef struct counters {
+                std::atomic<size_t> current{ 0 }, peak{ 0 }, allocations{ 0 };
+                std::atomic<bool> enabled{ false };
+            } counters;
+
+            // malloc itself would count the block a second time once it is replaced
+            static void* rawAllocate(size_t size) {
+                #ifdef __GLIBC__
+                    return __libc_malloc(size);
+                #else
+                    return std::malloc(size);
+                #endif
+            }
+
+            static void rawFree(void* p) {
+                #ifdef __GLIBC__
+                    __libc_free(p);
+                #else
+                    std::free(p);
+                #endif
+            }
+
+            static counters& state() {
+                static counters c;
+                return c;
+            }
+    };
+}
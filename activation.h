@@ -0,0 +1,94 @@
+/*
+ *  activation.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace math {
+    /// <summary>
+    /// transfer function tabulated on [xmin, xmax] and evaluated by linear interpolation.
+    /// Inputs outside of the interval are clamped to its bounds.
+    /// </summary>
+    typedef struct transferTable {
+        transferTable(double (*func)(double), double _xmin, double _xmax, size_t nintervals)
+            : xmin(_xmin), xmax(_xmax), invh(nintervals / (_xmax - _xmin)), values(nintervals + 2) {
+            const double h = (xmax - xmin) / nintervals;
+            for (size_t i = 0; i <= nintervals; ++i)
+                values[i] = func(xmin + i * h);
+            // guard entry, read (with weight 0) when x == xmax
+            values[nintervals + 1] = values[nintervals];
+        }
+
+        /// <summary>
+        /// approximated value of the transfer function at x
+        /// </summary>
+        double operator()(double x) const {
+            // NaN is passed through like by the exact functions, it must not reach the index
+            if (!(x == x))
+                return x;
+            const double t = (std::min(std::max(x, xmin), xmax) - xmin) * invh;
+            const size_t i = (size_t)t;
+            const double w = t - i;
+            return values[i] + w * (values[i + 1] - values[i]);
+        }
+
+        /// <summary>
+        /// y[i] = f(y[i]) for i in [0, n)
+        /// </summary>
+        void apply(double* y, size_t n) const {
+            for (size_t i = 0; i < n; ++i)
+                y[i] = (*this)(y[i]);
+        }
+
+        /// <summary>
+        /// table for the sigmoid with |table(x) - sigmoid(x)| <= maxError for all x.
+        /// Half of the error budget goes to the interpolation (h^2 / 8 * max|f''|, max|f''| = 1 / (6 sqrt(3))),
+        /// the other half to the clamped tails (1 - sigmoid(x) < exp(-x)).
+        /// </summary>
+        static transferTable sigmoid(double maxError) {
+            const double xmax = std::log(2 / maxError);
+            return transferTable(unarySigmoid, -xmax, xmax, nintervals(2 * xmax, maxError, 1 / (6 * std::sqrt(3.0))));
+        }
+
+        /// <summary>
+        /// table for tanh with |table(x) - tanh(x)| <= maxError for all x
+        /// (max|f''| = 4 / (3 sqrt(3)), 1 - tanh(x) < 2 exp(-2x))
+        /// </summary>
+        static transferTable tanh(double maxError) {
+            const double xmax = 0.5 * std::log(4 / maxError);
+            return transferTable(unaryTanh, -xmax, xmax, nintervals(2 * xmax, maxError, 4 / (3 * std::sqrt(3.0))));
+        }
+
+        /// <summary>
+        /// interval and inverse step size of the table
+        /// </summary>
+        double xmin, xmax, invh;
+
+        /// <summary>
+        /// tabulated values
+        /// </summary>
+        std::vector<double> values;
+
+        private:
+            /// <summary>
+            /// number of intervals such that the interpolation error is below maxError / 2
+            /// </summary>
+            static size_t nintervals(double width, double maxError, double maxSecondDerivative) {
+                const double h = std::sqrt(4 * maxError / maxSecondDerivative);
+                return std::max<size_t>(1, (size_t)std::ceil(width / h));
+            }
+
+            static double unarySigmoid(double x) {
+                return 1 / (1 + std::exp(-x));
+            }
+
+            static double unaryTanh(double x) {
+                return std::tanh(x);
+            }
+    } transferTable;
+}
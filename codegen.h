@@ -0,0 +1,132 @@
+/*
+ *  codegen.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <ios>
+#include <ostream>
+#include <string>
+
+#include "activation.h"
+#include "layout.h"
+
+namespace math {
+    // config of the generated header
+    typedef struct codegenOptions {
+        // namespace of the generated code
+        std::string name = "simplenn";
+        // layers with at most this many weights are fully unrolled, larger ones use fixed-size loops
+        size_t unrollLimit = 4096;
+    } codegenOptions;
+
+    /// <summary>
+    /// writes a trained network as a self-contained C++ header: the parameters become constexpr
+    /// arrays and the forward pass a fixed-size function. The generated code only needs <cmath>.
+    /// </summary>
+    class codegen {
+        public:
+            enum transfer { sigmoid, relu, tanh };
+
+            /// <summary>
+            /// write the header for a network with the given parameters (in the given layout, see
+            /// nn.layout) and transfer functions. If a table is given, the transfer function is
+            /// evaluated with the same table.
+            /// </summary>
+            static void writeHeader(std::ostream& os, const codegenOptions& options,
+                const parameterLayout& layout, const double* parameters,
+                transfer inner, transfer outer, double outerThetaSign,
+                const transferTable* innerTable = nullptr, const transferTable* outerTable = nullptr) {
+                const size_t ninputs = layout.ninputs, noutputs = layout.noutputs, nneurons = layout.nneurons;
+                const std::ios_base::fmtflags flags = os.flags();
+
+                os << "// generated by SimpleNN2, do not edit\n"
+                   << "#pragma once\n"
+                   << "#include <cmath>\n"
+                   << "#include <cstddef>\n\n"
+                   << "namespace " << options.name << " {\n"
+                   << "    constexpr std::size_t ninputs = " << ninputs << ", noutputs = " << noutputs << ", nneurons = " << nneurons << ";\n\n";
+
+                os << std::hexfloat;
+                writeArray(os, "iweights", "ninputs", parameters + layout.iweights, ninputs);
+                writeArray(os, "itheta", "ninputs", parameters + layout.itheta, ninputs);
+                writeArray(os, "hweights", "nneurons * ninputs", parameters + layout.hweights, nneurons * ninputs);
+                writeArray(os, "htheta", "nneurons", parameters + layout.htheta, nneurons);
+                writeArray(os, "oweights", "noutputs * nneurons", parameters + layout.oweights, noutputs * nneurons);
+                writeArray(os, "otheta", "noutputs", parameters + layout.otheta, noutputs);
+
+                writeTransfer(os, "innerTransfer", inner, innerTable);
+                writeTransfer(os, "outerTransfer", outer, outerTable);
+                os.flags(flags);
+
+                os << "    inline void calculate(const double* xx, double* yy) {\n"
+                   << "        double io[ninputs];\n"
+                   << "        double ho[nneurons];\n";
+                for (size_t i = 0; i < ninputs; ++i)
+                    os << "        io[" << i << "] = innerTransfer(iweights[" << i << "] * xx[" << i << "] - itheta[" << i << "]);\n";
+
+                writeLayer(os, options, "ho", "innerTransfer", "hweights", "io", "htheta", "-", nneurons, ninputs);
+                writeLayer(os, options, "yy", "outerTransfer", "oweights", "ho", "otheta", outerThetaSign < 0 ? "-" : "+", noutputs, nneurons);
+                os << "    }\n\n"
+                   << "    inline void calculate(const double (&xx)[ninputs], double (&yy)[noutputs]) {\n"
+                   << "        calculate(&xx[0], &yy[0]);\n"
+                   << "    }\n"
+                   << "}\n";
+            }
+
+        private:
+            static void writeArray(std::ostream& os, const char* name, const char* size, const double* values, size_t n) {
+                os << "    alignas(64) constexpr double " << name << "[" << (n == 0 ? "1" : size) << "] = {";
+                for (size_t i = 0; i < n; ++i)
+                    os << (i % 4 == 0 ? "\n        " : " ") << values[i] << (i + 1 < n ? "," : "");
+                os << "\n    };\n\n";
+            }
+
+            static void writeTransfer(std::ostream& os, const char* name, transfer func, const transferTable* table) {
+                if (table && func != relu) {
+                    const std::string values = std::string(name) + "Table";
+                    writeArray(os, values.c_str(), std::to_string(table->values.size()).c_str(), table->values.data(), table->values.size());
+                    os << "    inline double " << name << "(double x) {\n"
+                       << "        if (!(x == x))\n"
+                       << "            return x;\n"
+                       << "        const double t = (std::fmin(std::fmax(x, " << table->xmin << "), " << table->xmax << ") - " << table->xmin << ") * " << table->invh << ";\n"
+                       << "        const std::size_t i = (std::size_t)t;\n"
+                       << "        const double w = t - i;\n"
+                       << "        return " << values << "[i] + w * (" << values << "[i + 1] - " << values << "[i]);\n"
+                       << "    }\n\n";
+                    return;
+                }
+                os << "    inline double " << name << "(double x) {\n";
+                if (func == sigmoid)
+                    os << "        return 1 / (1 + std::exp(-x));\n";
+                else if (func == relu)
+                    os << "        return x >= 0 ? x : 0;\n";
+                else
+                    os << "        return std::tanh(x);\n";
+                os << "    }\n\n";
+            }
+
+            /// <summary>
+            /// out[r] = transfer(weights[r][:] * in - sign theta[r]) for r < rows
+            /// </summary>
+            static void writeLayer(std::ostream& os, const codegenOptions& options, const char* out, const char* transfer,
+                const char* weights, const char* in, const char* theta, const char* sign, size_t rows, size_t cols) {
+                if (rows * cols > options.unrollLimit) {
+                    os << "        for (std::size_t r = 0; r < " << rows << "; ++r) {\n"
+                       << "            double sum = 0;\n"
+                       << "            for (std::size_t c = 0; c < " << cols << "; ++c)\n"
+                       << "                sum += " << weights << "[r * " << cols << " + c] * " << in << "[c];\n"
+                       << "            " << out << "[r] = " << transfer << "(sum " << sign << " " << theta << "[r]);\n"
+                       << "        }\n";
+                    return;
+                }
+                for (size_t r = 0; r < rows; ++r) {
+                    os << "        " << out << "[" << r << "] = " << transfer << "(";
+                    for (size_t c = 0; c < cols; ++c)
+                        os << (c > 0 ? " + " : "") << weights << "[" << r * cols + c << "] * " << in << "[" << c << "]";
+                    os << (cols == 0 ? "0 " : " ") << sign << " " << theta << "[" << r << "]);\n";
+                }
+            }
+    };
+}
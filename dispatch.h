@@ -0,0 +1,334 @@
+/*
+ *  dispatch.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <Eigen/Dense>
+
+#include "activation.h"
+
+// x86 with gcc or clang: the kernels are compiled in several ISA variants, independent of -march
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define SIMPLENN_X86
+    #include <immintrin.h>
+    #define SIMPLENN_AVX2 __attribute__((target("avx2,fma")))
+    #define SIMPLENN_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#endif
+
+namespace math {
+    /// <summary>
+    /// the hot kernels of training and inference, one set per instruction set.
+    /// All matrices are row-major.
+    /// </summary>
+    typedef struct kernelTable {
+        // y = A x, A: rows x cols
+        void (*gemv)(const double* A, const double* x, double* y, size_t rows, size_t cols);
+        // y = A^T x
+        void (*gemvT)(const double* A, const double* x, double* y, size_t rows, size_t cols);
+        // A += x y^T
+        void (*ger)(double* A, const double* x, const double* y, size_t rows, size_t cols);
+        // p[i] -= alpha * mask[i] * g[i]
+        void (*update)(double* p, double alpha, const double* mask, const double* g, size_t n);
+        // sum (a[i] - b[i])^2
+        double (*squaredDistance)(const double* a, const double* b, size_t n);
+        // y[i] = table(y[i])
+        void (*interpolate)(const transferTable& table, double* y, size_t n);
+        // name of the instruction set
+        const char* name;
+    } kernelTable;
+
+    /// <summary>
+    /// selects the kernels for the CPU the process runs on. The instruction set is detected once
+    /// (CPUID); the environment variable SIMPLENN_ISA (generic, avx2, avx512) forces a variant,
+    /// but never one the CPU does not support.
+    /// </summary>
+    class cpu {
+        public:
+            enum isa { generic, avx2, avx512 };
+
+            /// <summary>
+            /// best instruction set supported by the CPU
+            /// </summary>
+            static isa detect() {
+                #ifdef SIMPLENN_X86
+                    __builtin_cpu_init();
+                    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                        return avx512;
+                    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                        return avx2;
+                #endif
+                return generic;
+            }
+
+            /// <summary>
+            /// instruction set named by value, fallback if value is null or unknown
+            /// </summary>
+            static isa parse(const char* value, isa fallback) {
+                if (!value)
+                    return fallback;
+                for (isa i : { generic, avx2, avx512 })
+                    if (std::strcmp(value, name(i)) == 0)
+                        return i;
+                return fallback;
+            }
+
+            static const char* name(isa i) {
+                return i == avx512 ? "avx512" : i == avx2 ? "avx2" : "generic";
+            }
+
+            /// <summary>
+            /// instruction set used by kernels(): the detected one, lowered by SIMPLENN_ISA
+            /// </summary>
+            static isa selected() {
+                static const isa i = std::min(detect(), parse(std::getenv("SIMPLENN_ISA"), detect()));
+                return i;
+            }
+
+            /// <summary>
+            /// kernels of the selected instruction set
+            /// </summary>
+            static const kernelTable& kernels() {
+                static const kernelTable& table = kernels(selected());
+                return table;
+            }
+
+            /// <summary>
+            /// kernels of instruction set i, which has to be supported by the CPU
+            /// </summary>
+            static const kernelTable& kernels(isa i) {
+                static const kernelTable tables[] = {
+                    make<genericKernels>("generic"),
+                    #ifdef SIMPLENN_X86
+                        make<avx2Kernels>("avx2"),
+                        make<avx512Kernels>("avx512")
+                    #else
+                        make<genericKernels>("generic"),
+                        make<genericKernels>("generic")
+                    #endif
+                };
+                return tables[i];
+            }
+
+        private:
+            template<typename K>
+            static kernelTable make(const char* name) {
+                return { &K::gemv, &K::gemvT, &K::ger, &K::update, &K::squaredDistance, &K::interpolate, name };
+            }
+
+            typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> rowMatrix;
+
+            /// <summary>
+            /// Eigen with the flags of the build
+            /// </summary>
+            struct genericKernels {
+                static void gemv(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+                    Eigen::Map<Eigen::VectorXd>(y, rows).noalias() = Eigen::Map<const rowMatrix>(A, rows, cols) * Eigen::Map<const Eigen::VectorXd>(x, cols);
+                }
+
+                static void gemvT(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+                    Eigen::Map<Eigen::VectorXd>(y, cols).noalias() = Eigen::Map<const rowMatrix>(A, rows, cols).transpose() * Eigen::Map<const Eigen::VectorXd>(x, rows);
+                }
+
+                static void ger(double* A, const double* x, const double* y, size_t rows, size_t cols) {
+                    Eigen::Map<rowMatrix>(A, rows, cols).noalias() += Eigen::Map<const Eigen::VectorXd>(x, rows) * Eigen::Map<const Eigen::VectorXd>(y, cols).transpose();
+                }
+
+                static void update(double* p, double alpha, const double* mask, const double* g, size_t n) {
+                    for (size_t i = 0; i < n; ++i)
+                        p[i] -= alpha * mask[i] * g[i];
+                }
+
+                static double squaredDistance(const double* a, const double* b, size_t n) {
+                    return (Eigen::Map<const Eigen::VectorXd>(a, n) - Eigen::Map<const Eigen::VectorXd>(b, n)).squaredNorm();
+                }
+
+                static void interpolate(const transferTable& table, double* y, size_t n) {
+                    table.apply(y, n);
+                }
+            };
+
+            #ifdef SIMPLENN_X86
+                // the intrinsics headers of gcc initialize their "undefined" registers with themselves
+                #pragma GCC diagnostic push
+                #pragma GCC diagnostic ignored "-Wuninitialized"
+                #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+                struct avx2Kernels {
+                    SIMPLENN_AVX2 static double hsum(__m256d v) {
+                        __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+                        return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+                    }
+
+                    SIMPLENN_AVX2 static double dot(const double* a, const double* b, size_t n) {
+                        __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+                        size_t i = 0;
+                        for (; i + 8 <= n; i += 8) {
+                            s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+                            s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), s1);
+                        }
+                        for (; i + 4 <= n; i += 4)
+                            s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+                        double s = hsum(_mm256_add_pd(s0, s1));
+                        for (; i < n; ++i)
+                            s += a[i] * b[i];
+                        return s;
+                    }
+
+                    // y += alpha x
+                    SIMPLENN_AVX2 static void axpy(double* y, double alpha, const double* x, size_t n) {
+                        const __m256d a = _mm256_set1_pd(alpha);
+                        size_t i = 0;
+                        for (; i + 4 <= n; i += 4)
+                            _mm256_storeu_pd(y + i, _mm256_fmadd_pd(a, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+                        for (; i < n; ++i)
+                            y[i] += alpha * x[i];
+                    }
+
+                    SIMPLENN_AVX2 static void gemv(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+                        for (size_t r = 0; r < rows; ++r)
+                            y[r] = dot(A + r * cols, x, cols);
+                    }
+
+                    SIMPLENN_AVX2 static void gemvT(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+                        std::fill(y, y + cols, 0.0);
+                        for (size_t r = 0; r < rows; ++r)
+                            axpy(y, x[r], A + r * cols, cols);
+                    }
+
+                    SIMPLENN_AVX2 static void ger(double* A, const double* x, const double* y, size_t rows, size_t cols) {
+                        for (size_t r = 0; r < rows; ++r)
+                            axpy(A + r * cols, x[r], y, cols);
+                    }
+
+                    SIMPLENN_AVX2 static void update(double* p, double alpha, const double* mask, const double* g, size_t n) {
+                        const __m256d a = _mm256_set1_pd(alpha);
+                        size_t i = 0;
+                        for (; i + 4 <= n; i += 4)
+                            _mm256_storeu_pd(p + i, _mm256_fnmadd_pd(_mm256_mul_pd(a, _mm256_loadu_pd(mask + i)), _mm256_loadu_pd(g + i), _mm256_loadu_pd(p + i)));
+                        for (; i < n; ++i)
+                            p[i] -= alpha * mask[i] * g[i];
+                    }
+
+                    SIMPLENN_AVX2 static double squaredDistance(const double* a, const double* b, size_t n) {
+                        __m256d s = _mm256_setzero_pd();
+                        size_t i = 0;
+                        for (; i + 4 <= n; i += 4) {
+                            const __m256d d = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+                            s = _mm256_fmadd_pd(d, d, s);
+                        }
+                        double r = hsum(s);
+                        for (; i < n; ++i)
+                            r += (a[i] - b[i]) * (a[i] - b[i]);
+                        return r;
+                    }
+
+                    SIMPLENN_AVX2 static void interpolate(const transferTable& table, double* y, size_t n) {
+                        const __m256d lo = _mm256_set1_pd(table.xmin), hi = _mm256_set1_pd(table.xmax), invh = _mm256_set1_pd(table.invh);
+                        const double* values = table.values.data();
+                        size_t i = 0;
+                        for (; i + 4 <= n; i += 4) {
+                            // max_pd maps NaN to lo, so the index stays in range; NaN is restored below
+                            const __m256d x = _mm256_loadu_pd(y + i);
+                            const __m256d t = _mm256_mul_pd(_mm256_sub_pd(_mm256_min_pd(_mm256_max_pd(x, lo), hi), lo), invh);
+                            const __m128i k = _mm256_cvttpd_epi32(t);
+                            const __m256d w = _mm256_sub_pd(t, _mm256_cvtepi32_pd(k));
+                            const __m256d v0 = _mm256_i32gather_pd(values, k, 8), v1 = _mm256_i32gather_pd(values + 1, k, 8);
+                            const __m256d r = _mm256_fmadd_pd(w, _mm256_sub_pd(v1, v0), v0);
+                            _mm256_storeu_pd(y + i, _mm256_blendv_pd(r, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q)));
+                        }
+                        for (; i < n; ++i)
+                            y[i] = table(y[i]);
+                    }
+                };
+
+                struct avx512Kernels {
+                    SIMPLENN_AVX512 static double dot(const double* a, const double* b, size_t n) {
+                        __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+                        size_t i = 0;
+                        for (; i + 16 <= n; i += 16) {
+                            s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+                            s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), s1);
+                        }
+                        if (i + 8 <= n) {
+                            s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+                            i += 8;
+                        }
+                        // remaining entries with a masked load
+                        const __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+                        s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, a + i), _mm512_maskz_loadu_pd(m, b + i), s1);
+                        return _mm512_reduce_add_pd(_mm512_add_pd(s0, s1));
+                    }
+
+                    // y += alpha x
+                    SIMPLENN_AVX512 static void axpy(double* y, double alpha, const double* x, size_t n) {
+                        const __m512d a = _mm512_set1_pd(alpha);
+                        size_t i = 0;
+                        for (; i + 8 <= n; i += 8)
+                            _mm512_storeu_pd(y + i, _mm512_fmadd_pd(a, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+                        const __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+                        _mm512_mask_storeu_pd(y + i, m, _mm512_fmadd_pd(a, _mm512_maskz_loadu_pd(m, x + i), _mm512_maskz_loadu_pd(m, y + i)));
+                    }
+
+                    SIMPLENN_AVX512 static void gemv(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+                        for (size_t r = 0; r < rows; ++r)
+                            y[r] = dot(A + r * cols, x, cols);
+                    }
+
+                    SIMPLENN_AVX512 static void gemvT(const double* A, const double* x, double* y, size_t rows, size_t cols) {
+                        std::fill(y, y + cols, 0.0);
+                        for (size_t r = 0; r < rows; ++r)
+                            axpy(y, x[r], A + r * cols, cols);
+                    }
+
+                    SIMPLENN_AVX512 static void ger(double* A, const double* x, const double* y, size_t rows, size_t cols) {
+                        for (size_t r = 0; r < rows; ++r)
+                            axpy(A + r * cols, x[r], y, cols);
+                    }
+
+                    SIMPLENN_AVX512 static void update(double* p, double alpha, const double* mask, const double* g, size_t n) {
+                        const __m512d a = _mm512_set1_pd(alpha);
+                        size_t i = 0;
+                        for (; i + 8 <= n; i += 8)
+                            _mm512_storeu_pd(p + i, _mm512_fnmadd_pd(_mm512_mul_pd(a, _mm512_loadu_pd(mask + i)), _mm512_loadu_pd(g + i), _mm512_loadu_pd(p + i)));
+                        for (; i < n; ++i)
+                            p[i] -= alpha * mask[i] * g[i];
+                    }
+
+                    SIMPLENN_AVX512 static double squaredDistance(const double* a, const double* b, size_t n) {
+                        __m512d s = _mm512_setzero_pd();
+                        size_t i = 0;
+                        for (; i + 8 <= n; i += 8) {
+                            const __m512d d = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+                            s = _mm512_fmadd_pd(d, d, s);
+                        }
+                        double r = _mm512_reduce_add_pd(s);
+                        for (; i < n; ++i)
+                            r += (a[i] - b[i]) * (a[i] - b[i]);
+                        return r;
+                    }
+
+                    SIMPLENN_AVX512 static void interpolate(const transferTable& table, double* y, size_t n) {
+                        const __m512d lo = _mm512_set1_pd(table.xmin), hi = _mm512_set1_pd(table.xmax), invh = _mm512_set1_pd(table.invh);
+                        const double* values = table.values.data();
+                        size_t i = 0;
+                        for (; i + 8 <= n; i += 8) {
+                            const __m512d x = _mm512_loadu_pd(y + i);
+                            const __m512d t = _mm512_mul_pd(_mm512_sub_pd(_mm512_min_pd(_mm512_max_pd(x, lo), hi), lo), invh);
+                            const __m256i k = _mm512_cvttpd_epi32(t);
+                            const __m512d w = _mm512_sub_pd(t, _mm512_cvtepi32_pd(k));
+                            const __m512d v0 = _mm512_i32gather_pd(k, values, 8), v1 = _mm512_i32gather_pd(k, values + 1, 8);
+                            const __m512d r = _mm512_fmadd_pd(w, _mm512_sub_pd(v1, v0), v0);
+                            _mm512_storeu_pd(y + i, _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, x, _CMP_UNORD_Q), r, x));
+                        }
+                        for (; i < n; ++i)
+                            y[i] = table(y[i]);
+                    }
+                };
+                #pragma GCC diagnostic pop
+            #endif
+    };
+}
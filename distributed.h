@@ -0,0 +1,430 @@
+/*
+ *  distributed.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "nn.h"
+
+namespace math {
+    // address of the parameter server
+    typedef struct endpoint {
+        // path of a unix domain socket, used if not empty
+        std::string path;
+        // host and port of a tcp socket otherwise (port 0: chosen by the system, see parameterServer::port)
+        std::string host = "127.0.0.1";
+        uint16_t port = 0;
+    } endpoint;
+
+    // config of the distributed training
+    typedef struct distributedOptions {
+        // number of workers the server waits for
+        size_t nworkers = 2;
+        // workers send their gradients as half precision floats (scaled by the largest entry)
+        bool compress = false;
+        // upper bound of the training steps
+        size_t maxSteps = SIZE_MAX;
+        // how long a worker retries to connect to the server (ms)
+        size_t connectTimeout = 10000;
+    } distributedOptions;
+
+    /// <summary>
+    /// synchronous data-parallel training. Every worker process holds one shard of the dataset.
+    /// In every step the server sends nn.parameters to all workers, the workers send back the loss
+    /// and gradient on their shard, and the server applies the summed gradient (which equals the
+    /// gradient on the whole dataset). Parameters and gradients are sent in the native byte order,
+    /// so all processes have to run on the same architecture.
+    /// </summary>
+    class parameterServer {
+        public:
+            /// <summary>
+            /// bind and listen on the endpoint, workers can connect as soon as the server exists
+            /// </summary>
+            parameterServer(const endpoint& _address)
+                : address(_address), listener(-1) {
+                listener = address.path.empty() ? listenTcp(address) : listenUnix(address.path);
+            }
+
+            ~parameterServer() {
+                closeAll();
+                if (listener >= 0)
+                    ::close(listener);
+                if (!address.path.empty())
+                    ::unlink(address.path.c_str());
+            }
+
+            parameterServer(const parameterServer&) = delete;
+            parameterServer& operator=(const parameterServer&) = delete;
+
+            /// <summary>
+            /// true if the server is listening
+            /// </summary>
+            bool valid() const {
+                return listener >= 0;
+            }
+
+            /// <summary>
+            /// tcp port the server listens on
+            /// </summary>
+            uint16_t port() const {
+                return address.port;
+            }
+
+            /// <summary>
+            /// wait for options.nworkers workers and train nn until the loss on the whole dataset
+            /// reached the accuracy (or options.maxSteps steps are done). The workers are stopped
+            /// afterwards. Returns false if a worker could not be reached or does not match nn.
+            /// </summary>
+            bool train(nn& nn, const double accuracy, const double learningrate, const distributedOptions& options) {
+                if (!valid() || !accept(nn, options.nworkers))
+                    return false;
+
+                const math::vector<double> mask(nn.ntotparameters, 1);
+                std::vector<double> gradient(nn.ntotparameters), received(nn.ntotparameters);
+                std::vector<uint16_t> halves(options.compress ? nn.ntotparameters : 0);
+                const header step = { command::step, options.compress ? 1u : 0u };
+
+                bool ok = true;
+                size_t counter = 0;
+                double lf = 0;
+                do {
+                    // broadcast the parameters
+                    for (int fd : workers)
+                        ok = ok && sendAll(fd, &step, sizeof(step))
+                            && sendAll(fd, nn.parameters.data(), nn.ntotparameters * sizeof(double));
+
+                    // sum up the losses and gradients in the order of the workers
+                    lf = 0;
+                    std::fill(gradient.begin(), gradient.end(), 0.0);
+                    for (int fd : workers) {
+                        double wlf = 0;
+                        ok = ok && recvAll(fd, &wlf, sizeof(wlf))
+                            && receiveGradient(fd, received, halves, options.compress);
+                        if (!ok)
+                            break;
+                        lf += wlf;
+                        for (size_t i = 0; i < nn.ntotparameters; ++i)
+                            gradient[i] += received[i];
+                    }
+                    if (!ok)
+                        break;
+
+                    supervisor::update(nn, gradient.data(), lf, learningrate, mask);
+
+                    // Status
+                    if (counter++ % 100 == 0)
+                        std::cout << "lf  = " << lf << std::endl;
+                } while (lf > accuracy && counter < options.maxSteps);
+
+                const header stop = { command::stop, 0 };
+                for (int fd : workers)
+                    sendAll(fd, &stop, sizeof(stop));
+                closeAll();
+                return ok;
+            }
+
+            /// <summary>
+            /// worker loop: connect to the server and compute gradients of nn on the shard until the
+            /// server stops the training. nn has to have the same shape as the network of the server.
+            /// Returns false if the connection failed.
+            /// </summary>
+            static bool work(const endpoint& address, nn& nn, const std::vector<dataSet>& shard, const distributedOptions& options = distributedOptions()) {
+                const int fd = connect(address, options.connectTimeout);
+                if (fd < 0)
+                    return false;
+
+                workspace ws = supervisor::createWorkspace(nn);
+                std::vector<uint16_t> halves(nn.ntotparameters);
+                const uint64_t nparameters = nn.ntotparameters;
+                bool ok = sendAll(fd, &nparameters, sizeof(nparameters));
+                while (ok) {
+                    header h;
+                    ok = recvAll(fd, &h, sizeof(h));
+                    if (!ok || h.cmd == command::stop)
+                        break;
+                    ok = recvAll(fd, nn.parameters.data(), nn.ntotparameters * sizeof(double));
+                    if (!ok)
+                        break;
+
+                    const double lf = supervisor::gradient(nn, shard, ws);
+                    ok = sendAll(fd, &lf, sizeof(lf)) && sendGradient(fd, ws.gradient, halves, nn.ntotparameters, h.compress != 0);
+                }
+                ::close(fd);
+                return ok;
+            }
+
+            /// <summary>
+            /// shard k of n of the dataset (contiguous, sizes differ by at most one)
+            /// </summary>
+            static std::vector<dataSet> shard(const std::vector<dataSet>& dataset, size_t k, size_t n) {
+                const size_t first = dataset.size() * k / n, last = dataset.size() * (k + 1) / n;
+                return std::vector<dataSet>(dataset.begin() + first, dataset.begin() + last);
+            }
+
+            /// <summary>
+            /// IEEE half precision with round to nearest even
+            /// </summary>
+            static uint16_t toHalf(float f) {
+                uint32_t x;
+                std::memcpy(&x, &f, sizeof(x));
+                const uint16_t sign = (x >> 16) & 0x8000;
+                const uint32_t biased = (x >> 23) & 0xff;
+                uint32_t mantissa = x & 0x7fffff;
+                if (biased == 0xff)
+                    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+                const int32_t exponent = (int32_t)biased - 127 + 15;
+                if (exponent >= 31)
+                    return sign | 0x7c00;
+                if (exponent <= 0) {
+                    // subnormal or zero
+                    if (exponent < -10)
+                        return sign;
+                    mantissa |= 0x800000;
+                    const uint32_t shift = 14 - exponent;
+                    return sign | roundHalf(mantissa >> shift, mantissa & ((1u << shift) - 1), 1u << (shift - 1));
+                }
+                // a carry out of the mantissa correctly increments the exponent
+                return sign | roundHalf(((uint32_t)exponent << 10) | (mantissa >> 13), mantissa & 0x1fff, 0x1000);
+            }
+
+            static float fromHalf(uint16_t h) {
+                const uint32_t exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+                float f;
+                if (exponent == 0)
+                    f = std::ldexp((float)mantissa, -24);
+                else if (exponent == 31)
+                    f = mantissa ? NAN : INFINITY;
+                else
+                    f = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+                return (h & 0x8000) ? -f : f;
+            }
+
+        private:
+            enum class command : uint32_t { stop, step };
+
+            typedef struct header {
+                command cmd;
+                uint32_t compress;
+            } header;
+
+            static uint16_t roundHalf(uint32_t h, uint32_t rest, uint32_t half) {
+                return (uint16_t)(rest > half || (rest == half && (h & 1)) ? h + 1 : h);
+            }
+
+            /// <summary>
+            /// compressed: the largest absolute entry s followed by the entries / s as half precision floats
+            /// </summary>
+            static bool sendGradient(int fd, const double* gradient, std::vector<uint16_t>& halves, size_t n, bool compress) {
+                if (!compress)
+                    return sendAll(fd, gradient, n * sizeof(double));
+                double scale = 0;
+                for (size_t i = 0; i < n; ++i)
+                    scale = std::max(scale, std::abs(gradient[i]));
+                const double inv = scale > 0 ? 1 / scale : 0;
+                for (size_t i = 0; i < n; ++i)
+                    halves[i] = toHalf((float)(gradient[i] * inv));
+                return sendAll(fd, &scale, sizeof(scale)) && sendAll(fd, halves.data(), n * sizeof(uint16_t));
+            }
+
+            static bool receiveGradient(int fd, std::vector<double>& gradient, std::vector<uint16_t>& halves, bool compress) {
+                if (!compress)
+                    return recvAll(fd, gradient.data(), gradient.size() * sizeof(double));
+                double scale = 0;
+                if (!recvAll(fd, &scale, sizeof(scale)) || !recvAll(fd, halves.data(), halves.size() * sizeof(uint16_t)))
+                    return false;
+                for (size_t i = 0; i < gradient.size(); ++i)
+                    gradient[i] = scale * fromHalf(halves[i]);
+                return true;
+            }
+
+            /// <summary>
+            /// accept n workers and check that their networks have as many parameters as nn
+            /// </summary>
+            bool accept(const nn& nn, size_t n) {
+                closeAll();
+                while (workers.size() < n) {
+                    const int fd = ::accept(listener, nullptr, nullptr);
+                    if (fd < 0)
+                        return false;
+                    configure(fd);
+                    workers.push_back(fd);
+                    uint64_t nparameters = 0;
+                    if (!recvAll(fd, &nparameters, sizeof(nparameters)) || nparameters != nn.ntotparameters)
+                        return false;
+                }
+                return true;
+            }
+
+            void closeAll() {
+                for (int fd : workers)
+                    ::close(fd);
+                workers.clear();
+            }
+
+            static bool sendAll(int fd, const void* data, size_t size) {
+                const char* p = static_cast<const char*>(data);
+                while (size > 0) {
+                    const ssize_t n = ::send(fd, p, size, sendFlags);
+                    if (n <= 0)
+                        return false;
+                    p += n;
+                    size -= n;
+                }
+                return true;
+            }
+
+            static bool recvAll(int fd, void* data, size_t size) {
+                char* p = static_cast<char*>(data);
+                while (size > 0) {
+                    const ssize_t n = ::recv(fd, p, size, 0);
+                    if (n <= 0)
+                        return false;
+                    p += n;
+                    size -= n;
+                }
+                return true;
+            }
+
+            /// <summary>
+            /// no SIGPIPE if the peer is gone (send fails instead), no Nagle delay on tcp
+            /// </summary>
+            static void configure(int fd) {
+                const int one = 1;
+                #ifdef SO_NOSIGPIPE
+                    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+                #endif
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+
+            static int listenUnix(const std::string& path) {
+                sockaddr_un addr;
+                if (path.size() >= sizeof(addr.sun_path))
+                    return -1;
+                std::memset(&addr, 0, sizeof(addr));
+                addr.sun_family = AF_UNIX;
+                std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+                ::unlink(path.c_str());
+
+                const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                if (fd >= 0 && (::bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0)) {
+                    ::close(fd);
+                    return -1;
+                }
+                return fd;
+            }
+
+            /// <summary>
+            /// listen on address.host:address.port, the chosen port is written back to address.port
+            /// </summary>
+            static int listenTcp(endpoint& address) {
+                addrinfo hints, *info = nullptr;
+                std::memset(&hints, 0, sizeof(hints));
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                hints.ai_flags = AI_PASSIVE;
+                if (::getaddrinfo(address.host.c_str(), std::to_string(address.port).c_str(), &hints, &info) != 0)
+                    return -1;
+
+                int fd = -1;
+                for (addrinfo* ai = info; ai && fd < 0; ai = ai->ai_next) {
+                    fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+                    if (fd < 0)
+                        continue;
+                    const int one = 1;
+                    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                    if (::bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+                        ::close(fd);
+                        fd = -1;
+                    }
+                }
+                ::freeaddrinfo(info);
+
+                sockaddr_storage bound;
+                socklen_t length = sizeof(bound);
+                if (fd >= 0 && ::getsockname(fd, (sockaddr*)&bound, &length) == 0)
+                    address.port = ntohs(bound.ss_family == AF_INET6 ? ((sockaddr_in6*)&bound)->sin6_port : ((sockaddr_in*)&bound)->sin_port);
+                return fd;
+            }
+
+            /// <summary>
+            /// connect to the server, retrying until the timeout (ms) is reached
+            /// </summary>
+            static int connect(const endpoint& address, size_t timeout) {
+                const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+                for (;;) {
+                    const int fd = address.path.empty() ? connectTcp(address) : connectUnix(address.path);
+                    if (fd >= 0) {
+                        configure(fd);
+                        return fd;
+                    }
+                    if (std::chrono::steady_clock::now() >= deadline)
+                        return -1;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+
+            static int connectUnix(const std::string& path) {
+                sockaddr_un addr;
+                if (path.size() >= sizeof(addr.sun_path))
+                    return -1;
+                std::memset(&addr, 0, sizeof(addr));
+                addr.sun_family = AF_UNIX;
+                std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+                const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                if (fd >= 0 && ::connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+                    ::close(fd);
+                    return -1;
+                }
+                return fd;
+            }
+
+            static int connectTcp(const endpoint& address) {
+                addrinfo hints, *info = nullptr;
+                std::memset(&hints, 0, sizeof(hints));
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                if (::getaddrinfo(address.host.c_str(), std::to_string(address.port).c_str(), &hints, &info) != 0)
+                    return -1;
+
+                int fd = -1;
+                for (addrinfo* ai = info; ai && fd < 0; ai = ai->ai_next) {
+                    fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+                    if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+                        ::close(fd);
+                        fd = -1;
+                    }
+                }
+                ::freeaddrinfo(info);
+                return fd;
+            }
+
+            #ifdef MSG_NOSIGNAL
+                static constexpr int sendFlags = MSG_NOSIGNAL;
+            #else
+                static constexpr int sendFlags = 0;
+            #endif
+
+            endpoint address;
+            int listener;
+            std::vector<int> workers;
+    };
+}
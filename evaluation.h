@@ -0,0 +1,48 @@
+/*
+ *  evaluation.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <cmath>
+#include <vector>
+
+namespace math {
+    /// <summary>
+    /// compensated (Kahan-Babuska-Neumaier) summation: the rounding error of every addition is
+    /// carried along, so the sum of many terms is accurate to a few ulps independent of their count
+    /// </summary>
+    typedef struct compensatedSum {
+        double sum = 0, compensation = 0;
+
+        void add(double x) {
+            const double t = sum + x;
+            if (std::fabs(sum) >= std::fabs(x))
+                compensation += (sum - t) + x;
+            else
+                compensation += (x - t) + sum;
+            sum = t;
+        }
+
+        double value() const {
+            return sum + compensation;
+        }
+    } compensatedSum;
+
+    /// <summary>
+    /// loss and metrics of a network on a dataset (see supervisor::evaluate)
+    /// </summary>
+    typedef struct evaluation {
+        size_t nsamples = 0;
+        // sum of |ooutput - yy| / 2 over all samples, the loss train minimizes
+        double loss = 0;
+        // mean of (ooutput - yy)^2 over all samples and outputs
+        double mse = 0;
+        // fraction of correctly classified samples: the largest output matches the largest
+        // target, for a single output both are on the same side of 0.5
+        double accuracy = 0;
+        // mean absolute error of every output
+        std::vector<double> outputError;
+    } evaluation;
+}
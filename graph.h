@@ -0,0 +1,57 @@
+/*
+ *  graph.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "activation.h"
+
+namespace math {
+    /// <summary>
+    /// inference-only form of a trained network (see supervisor::compile). Inputs with zero
+    /// weight and hidden neurons without incoming weights are constant; their contribution is
+    /// folded into the thresholds of the next layer. Hidden neurons without outgoing weights
+    /// are dropped. The input scaling, threshold and transfer function are evaluated in one
+    /// fused pass, all activations live in a single buffer.
+    /// </summary>
+    typedef struct compiledNN {
+        compiledNN()
+            : ninputs(0), noutputs(0), nlinputs(0), nlneurons(0) {}
+
+        /// <summary>
+        /// indices of the live inputs and their scaling and thresholds
+        /// </summary>
+        std::vector<uint32_t> inputs;
+        std::vector<double> iweights, itheta;
+
+        /// <summary>
+        /// row-major hidden weights [nlneurons][nlinputs] and thresholds with the constant inputs folded in
+        /// </summary>
+        std::vector<double> hweights, htheta;
+
+        /// <summary>
+        /// row-major output weights [noutputs][nlneurons] and thresholds with the constant neurons folded in
+        /// </summary>
+        std::vector<double> oweights, otheta;
+
+        /// <summary>
+        /// tables of the approximated transfer functions, if the network uses them
+        /// </summary>
+        std::shared_ptr<const transferTable> inner, outer;
+
+        /// <summary>
+        /// activations of the live inputs followed by those of the live neurons
+        /// </summary>
+        mutable std::vector<double> buffer;
+
+        /// <summary>
+        /// number of inputs and outputs of the original network, number of live inputs and neurons
+        /// </summary>
+        size_t ninputs, noutputs, nlinputs, nlneurons;
+    } compiledNN;
+}
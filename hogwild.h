@@ -0,0 +1,196 @@
+/*
+ *  hogwild.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "nn.h"
+
+namespace math {
+    // config of the asynchronous training
+    typedef struct hogwildOptions {
+        // worker threads, every worker draws its samples from its own shard of the dataset
+        size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+        // samples per update of a worker
+        size_t batch = 8;
+        // a worker re-reads the shared parameters every refresh batches and trains on its stale
+        // replica in between, a larger value amortizes the copy but ignores the updates of the
+        // other workers (and all but the last of its own) for longer
+        size_t refresh = 1;
+        // upper bound of the epochs (passes over the whole dataset)
+        size_t maxEpochs = SIZE_MAX;
+        uint64_t seed = 5489;
+    } hogwildOptions;
+
+    /// <summary>
+    /// epochs and updates of an asynchronous training, the loss of the last epoch and the time
+    /// it took
+    /// </summary>
+    typedef struct hogwildReport {
+        size_t epochs = 0, updates = 0;
+        double loss = 0;
+        double seconds = 0;
+    } hogwildReport;
+
+    /// <summary>
+    /// asynchronous (Hogwild) training: the workers run forward and backward passes on their own
+    /// mini-batches and subtract learningrate times the gradient of the batch from the shared
+    /// parameters without any lock. An update can read parameters another worker is just
+    /// writing and concurrent updates of the same parameter can overwrite each other; both only
+    /// delay the training a little as long as the updates are small and rarely overlap, which
+    /// holds for small learning rates and sparse gradients.
+    /// Every parameter is read and written with relaxed atomic loads and stores, so a torn value
+    /// is never seen. The only barrier is the end of an epoch. cconfig.adaptive is not applied.
+    /// Per batch a worker walks its gradient once to apply and clear it and every
+    /// options.refresh batches it copies the layers that are not frozen from the shared
+    /// parameters: O(ntotparameters) on top of the batch forward and backward passes, about a
+    /// fifth of the time of a batch of 8 on a 32-256-8 network and a few percent with batch 64.
+    /// Every sample of a dense network touches every weight, so neither walk can be narrowed to
+    /// the touched parameters. The loss of every epoch is left to the caller, train does not print.
+    /// </summary>
+    class hogwild {
+        public:
+            /// <summary>
+            /// train the network until the loss of an epoch (the sum of the sample losses, each
+            /// computed before the update of its batch) is at most accuracy, only parameters with
+            /// mask[i] != 0 that are not in a frozen layer are updated
+            /// </summary>
+            static hogwildReport train(nn& nn, const std::vector<dataSet>& dataset, const double accuracy, const double learningrate,
+                const math::vector<double>& mask, const hogwildOptions& options = hogwildOptions()) {
+                auto t_start = std::chrono::high_resolution_clock::now();
+                hogwildReport report;
+                const size_t nworkers = std::max<size_t>(1, std::min(options.nthreads, dataset.size()));
+                const size_t batch = std::max<size_t>(1, options.batch);
+                const size_t refresh = std::max<size_t>(1, options.refresh);
+                const math::vector<double> active = activeMask(nn, mask);
+                const std::vector<std::pair<size_t, size_t>> ranges = activeRanges(nn);
+                threadPool pool(nworkers);
+
+                // private replica, workspace, sample order and generator of every worker
+                std::vector<math::nn> replicas;
+                std::vector<workspace> ws;
+                std::vector<std::vector<size_t>> order(nworkers);
+                std::vector<random::xoshiro256> gens;
+                std::vector<double> losses(nworkers);
+                std::vector<size_t> updates(nworkers);
+                replicas.reserve(nworkers);
+                ws.reserve(nworkers);
+                gens.reserve(nworkers);
+                for (size_t w = 0; w < nworkers; ++w) {
+                    replicas.emplace_back(nn);
+                    ws.push_back(supervisor::createWorkspace(nn));
+                    std::fill(ws[w].gradient, ws[w].gradient + nn.ntotparameters, 0.0);
+                    gens.emplace_back(options.seed, w);
+                }
+
+                while (report.epochs < options.maxEpochs) {
+                    pool.parallelFor(0, dataset.size(), nworkers, [&](size_t first, size_t last, size_t w) {
+                        std::vector<size_t>& o = order[w];
+                        o.resize(last - first);
+                        std::iota(o.begin(), o.end(), first);
+                        std::shuffle(o.begin(), o.end(), gens[w]);
+                        losses[w] = 0;
+                        updates[w] = 0;
+                        for (size_t b = 0, k = 0; b < o.size(); b += batch, ++k) {
+                            if (k % refresh == 0)
+                                read(nn, replicas[w], ranges);
+                            const size_t end = std::min(b + batch, o.size());
+                            for (size_t s = b; s < end; ++s)
+                                losses[w] += supervisor::accumulate(replicas[w], dataset[o[s]], ws[w]);
+                            write(nn, learningrate, active, ws[w].gradient);
+                            ++updates[w];
+                        }
+                    });
+
+                    report.loss = 0;
+                    for (size_t w = 0; w < nworkers; ++w) {
+                        report.loss += losses[w];
+                        report.updates += updates[w];
+                    }
+                    ++report.epochs;
+                    if (report.loss <= accuracy)
+                        break;
+                }
+
+                auto t_end = std::chrono::high_resolution_clock::now();
+                report.seconds = std::chrono::duration<double>(t_end - t_start).count();
+                return report;
+            }
+
+        private:
+            /// <summary>
+            /// mask with the parameters of the frozen layers set to zero
+            /// </summary>
+            static math::vector<double> activeMask(const nn& nn, const math::vector<double>& mask) {
+                math::vector<double> active(mask);
+                const freezing& freeze = nn.cconfig.freeze;
+                const size_t bounds[4] = { 0, nn.layout.hweights, nn.layout.oweights, nn.ntotparameters };
+                const bool frozen[3] = { freeze.input, freeze.hidden, freeze.output };
+                for (int l = 0; l < 3; ++l)
+                    if (frozen[l])
+                        std::fill(active.data() + bounds[l], active.data() + bounds[l + 1], 0.0);
+                return active;
+            }
+
+            /// <summary>
+            /// parameter ranges of the layers that are not frozen, the only ones that change
+            /// </summary>
+            static std::vector<std::pair<size_t, size_t>> activeRanges(const nn& nn) {
+                std::vector<std::pair<size_t, size_t>> ranges;
+                const freezing& freeze = nn.cconfig.freeze;
+                const size_t bounds[4] = { 0, nn.layout.hweights, nn.layout.oweights, nn.ntotparameters };
+                const bool frozen[3] = { freeze.input, freeze.hidden, freeze.output };
+                for (int l = 0; l < 3; ++l) {
+                    if (frozen[l])
+                        continue;
+                    if (!ranges.empty() && ranges.back().second == bounds[l])
+                        ranges.back().second = bounds[l + 1];
+                    else
+                        ranges.emplace_back(bounds[l], bounds[l + 1]);
+                }
+                return ranges;
+            }
+
+            /// <summary>
+            /// copy the shared parameters of the given ranges into the replica of a worker, the
+            /// frozen layers of the replica keep their initial copy
+            /// </summary>
+            static void read(const nn& shared, nn& replica, const std::vector<std::pair<size_t, size_t>>& ranges) {
+                const double* p = shared.parameters.data();
+                double* r = replica.parameters.data();
+                for (const auto& range : ranges)
+                    for (size_t i = range.first; i < range.second; ++i)
+                        __atomic_load(p + i, r + i, __ATOMIC_RELAXED);
+            }
+
+            /// <summary>
+            /// p[i] -= learningrate * mask[i] * g[i] on the shared parameters and g[i] = 0 for
+            /// the next batch. Parameters without a gradient are not touched (no write, no cache
+            /// line taken from other workers).
+            /// </summary>
+            static void write(nn& shared, const double learningrate, const math::vector<double>& mask, double* g) {
+                double* p = shared.parameters.data();
+                const double* m = mask.data();
+                for (size_t i = 0; i < shared.ntotparameters; ++i) {
+                    if (g[i] == 0)
+                        continue;
+                    if (m[i] != 0) {
+                        double value;
+                        __atomic_load(p + i, &value, __ATOMIC_RELAXED);
+                        value -= learningrate * m[i] * g[i];
+                        __atomic_store(p + i, &value, __ATOMIC_RELAXED);
+                    }
+                    g[i] = 0;
+                }
+            }
+    };
+}
@@ -0,0 +1,238 @@
+/*
+ *  inferencecache.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "modelhandle.h"
+
+namespace math {
+    /// <summary>
+    /// counters of an inferenceCache. A lookup is either a hit or a miss; a miss on an entry
+    /// of an older model version than the one looked up also counts as invalidation.
+    /// </summary>
+    typedef struct cacheStats {
+        size_t hits = 0, misses = 0, evictions = 0, invalidations = 0;
+
+        double hitRate() const {
+            return hits + misses ? (double)hits / (hits + misses) : 0;
+        }
+    } cacheStats;
+
+    /// <summary>
+    /// bounded LRU cache of network outputs in front of inference, keyed by a hash of the input
+    /// bytes and the model version. The cache is split into shards with one lock each, so
+    /// concurrent lookups of different inputs rarely contend. Entries of an older model version
+    /// are dropped when they are looked up; a lookup or insert with an older version than the
+    /// entry (a request still running on the previous model) leaves it alone. Once full, inserting reuses the least recently
+    /// used entry of the shard and its node in the index, so it does not allocate as long as
+    /// the inputs and outputs keep their sizes.
+    /// </summary>
+    class inferenceCache {
+            typedef struct entry {
+                uint64_t hash, version;
+                math::vector<double> xx, yy;
+                // false once the entry was dropped, it is then reused first
+                bool cached;
+            } entry;
+
+            typedef std::unordered_multimap<uint64_t, std::list<entry>::iterator> indexMap;
+
+            typedef struct shard {
+                std::mutex mutex;
+                // most recently used entry first
+                std::list<entry> lru;
+                indexMap index;
+                // index nodes of the dropped entries, reused for the next insert
+                std::vector<indexMap::node_type> spare;
+            } shard;
+
+        public:
+            inferenceCache(size_t _capacity, size_t nshards = 16)
+                : shards(std::max<size_t>(1, std::min(nshards, _capacity))),
+                  capacity((std::max<size_t>(1, _capacity) + shards.size() - 1) / shards.size()) {
+                // the index never rehashes and dropping an entry never allocates
+                for (auto& s : shards) {
+                    s.index.reserve(capacity);
+                    s.spare.reserve(capacity);
+                }
+            }
+
+            inferenceCache(const inferenceCache&) = delete;
+            inferenceCache& operator=(const inferenceCache&) = delete;
+
+            /// <summary>
+            /// hash of the bytes of a vector of doubles, 8 bytes per multiplication
+            /// </summary>
+            static uint64_t hash(const double* x, size_t n) {
+                uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+                for (size_t i = 0; i < n; ++i) {
+                    uint64_t bits;
+                    std::memcpy(&bits, x + i, sizeof(bits));
+                    h = (h ^ bits) * 0xbf58476d1ce4e5b9ULL;
+                    h ^= h >> 31;
+                }
+                h *= 0x94d049bb133111ebULL;
+                return h ^ (h >> 29);
+            }
+
+            /// <summary>
+            /// copy the cached output of xx under the given model version into yy (resized if
+            /// needed), returns false if there is none
+            /// </summary>
+            bool lookup(const math::vector<double>& xx, uint64_t version, math::vector<double>& yy) {
+                const uint64_t h = hash(xx.data(), xx.size());
+                shard& s = shardOf(h);
+                std::unique_lock<std::mutex> lock(s.mutex);
+                auto range = s.index.equal_range(h);
+                for (auto it = range.first; it != range.second; ++it) {
+                    entry& e = *it->second;
+                    if (!equal(e.xx, xx))
+                        continue;
+                    if (e.version > version)
+                        break;
+                    if (e.version < version) {
+                        // computed by an older model, drop it
+                        s.lru.splice(s.lru.end(), s.lru, it->second);
+                        s.spare.push_back(s.index.extract(it));
+                        s.lru.back().cached = false;
+                        ++invalidations;
+                        break;
+                    }
+                    s.lru.splice(s.lru.begin(), s.lru, it->second);
+                    if (yy.size() != e.yy.size())
+                        yy = math::vector<double>(e.yy.size());
+                    std::copy(e.yy.data(), e.yy.data() + e.yy.size(), yy.data());
+                    ++hits;
+                    return true;
+                }
+                ++misses;
+                return false;
+            }
+
+            /// <summary>
+            /// store the output yy of xx under the given model version
+            /// </summary>
+            void insert(const math::vector<double>& xx, uint64_t version, const math::vector<double>& yy) {
+                const uint64_t h = hash(xx.data(), xx.size());
+                shard& s = shardOf(h);
+                std::unique_lock<std::mutex> lock(s.mutex);
+                auto range = s.index.equal_range(h);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (equal(it->second->xx, xx)) {
+                        if (it->second->version > version)
+                            return;
+                        assign(*it->second, h, version, xx, yy);
+                        s.lru.splice(s.lru.begin(), s.lru, it->second);
+                        return;
+                    }
+                }
+
+                if (s.lru.size() < capacity) {
+                    s.lru.push_front(entry{ h, version, xx, yy, true });
+                    s.index.emplace(h, s.lru.begin());
+                    return;
+                }
+
+                // reuse the least recently used entry, dropped entries are at the back as well.
+                // Its index node is either still in the index or one of the spare nodes.
+                auto last = std::prev(s.lru.end());
+                indexMap::node_type node;
+                if (last->cached) {
+                    node = extractIndex(s, last);
+                    ++evictions;
+                } else {
+                    node = std::move(s.spare.back());
+                    s.spare.pop_back();
+                }
+                assign(*last, h, version, xx, yy);
+                s.lru.splice(s.lru.begin(), s.lru, last);
+                node.key() = h;
+                node.mapped() = s.lru.begin();
+                s.index.insert(std::move(node));
+            }
+
+            /// <summary>
+            /// outputs of the live model of the reader for xx, from the cache if possible.
+            /// ws is used for the inference on a miss.
+            /// </summary>
+            void calculateNN(const math::vector<double>& xx, modelHandle::reader& reader, workspace& ws, math::vector<double>& yy) {
+                const modelHandle::snapshot snap = reader.read();
+                if (lookup(xx, snap.number(), yy))
+                    return;
+                supervisor::calculateNN(xx, snap.model(), ws);
+                if (yy.size() != snap.model().noutputs)
+                    yy = math::vector<double>(snap.model().noutputs);
+                std::copy(ws.ooutput, ws.ooutput + snap.model().noutputs, yy.data());
+                insert(xx, snap.number(), yy);
+            }
+
+            cacheStats stats() const {
+                cacheStats c;
+                c.hits = hits.load();
+                c.misses = misses.load();
+                c.evictions = evictions.load();
+                c.invalidations = invalidations.load();
+                return c;
+            }
+
+            /// <summary>
+            /// number of cached outputs
+            /// </summary>
+            size_t size() {
+                size_t n = 0;
+                for (auto& s : shards) {
+                    std::unique_lock<std::mutex> lock(s.mutex);
+                    n += s.index.size();
+                }
+                return n;
+            }
+
+        private:
+            shard& shardOf(uint64_t h) {
+                return shards[(h >> 32) % shards.size()];
+            }
+
+            static bool equal(const math::vector<double>& a, const math::vector<double>& b) {
+                return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+            }
+
+            /// <summary>
+            /// overwrite an entry, the buffers are reused if the sizes match
+            /// </summary>
+            static void assign(entry& e, uint64_t h, uint64_t version, const math::vector<double>& xx, const math::vector<double>& yy) {
+                e.hash = h;
+                e.version = version;
+                e.cached = true;
+                if (e.xx.size() != xx.size())
+                    e.xx = math::vector<double>(xx.size());
+                if (e.yy.size() != yy.size())
+                    e.yy = math::vector<double>(yy.size());
+                std::copy(xx.data(), xx.data() + xx.size(), e.xx.data());
+                std::copy(yy.data(), yy.data() + yy.size(), e.yy.data());
+            }
+
+            static indexMap::node_type extractIndex(shard& s, std::list<entry>::iterator e) {
+                auto range = s.index.equal_range(e->hash);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (it->second == e)
+                        return s.index.extract(it);
+                }
+                return indexMap::node_type();
+            }
+
+            std::vector<shard> shards;
+            const size_t capacity;
+            std::atomic<size_t> hits{ 0 }, misses{ 0 }, evictions{ 0 }, invalidations{ 0 };
+    };
+}
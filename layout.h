@@ -0,0 +1,84 @@
+/*
+ *  layout.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#ifdef __linux__
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace math {
+    /// <summary>
+    /// offsets of the parameter blocks (iweights, itheta, hweights, htheta, oweights, otheta) of
+    /// a network in one flat array. Every block starts on a cache line and is followed by zeros
+    /// up to the next one, so that the blocks can be loaded aligned and threads that update
+    /// different blocks never write to the same cache line. The rows of hweights and oweights are
+    /// not padded, the kernels expect them back to back.
+    /// </summary>
+    typedef struct parameterLayout {
+        parameterLayout(size_t _ninputs, size_t _noutputs, size_t _nneurons)
+            : iweights(0),
+            itheta(iweights + pad(_ninputs)),
+            hweights(itheta + pad(_ninputs)),
+            htheta(hweights + pad(_nneurons * _ninputs)),
+            oweights(htheta + pad(_nneurons)),
+            otheta(oweights + pad(_noutputs * _nneurons)),
+            size(otheta + pad(_noutputs)),
+            ninputs(_ninputs), noutputs(_noutputs), nneurons(_nneurons) {}
+
+        /// <summary>
+        /// true if parameter i is padding behind a block
+        /// </summary>
+        bool padding(size_t i) const {
+            const size_t begin[6] = { iweights, itheta, hweights, htheta, oweights, otheta };
+            const size_t length[6] = { ninputs, ninputs, nneurons * ninputs, nneurons, noutputs * nneurons, noutputs };
+            for (int b = 0; b < 6; ++b)
+                if (i >= begin[b] && i < begin[b] + length[b])
+                    return false;
+            return true;
+        }
+
+        /// <summary>
+        /// number of doubles per cache line, n rounded up to whole cache lines
+        /// </summary>
+        static constexpr size_t line = 64 / sizeof(double);
+
+        static constexpr size_t pad(size_t n) {
+            return (n + line - 1) / line * line;
+        }
+
+        /// <summary>
+        /// first parameter of every block and number of parameters including the padding
+        /// </summary>
+        const size_t iweights, itheta, hweights, htheta, oweights, otheta, size;
+
+        /// <summary>
+        /// number of inputs, outputs and neurons
+        /// </summary>
+        const size_t ninputs, noutputs, nneurons;
+    } parameterLayout;
+
+    /// <summary>
+    /// ask the kernel to back the whole pages of [p, p + bytes) with transparent huge pages.
+    /// Only a hint: it returns false if the system does not support it, the memory stays valid.
+    /// </summary>
+    inline bool adviseHugePages(void* p, size_t bytes) {
+        #if defined(__linux__) && defined(MADV_HUGEPAGE)
+            const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+            const uintptr_t begin = ((uintptr_t)p + page - 1) / page * page;
+            const uintptr_t end = ((uintptr_t)p + bytes) / page * page;
+            if (end <= begin)
+                return false;
+            return madvise((void*)begin, end - begin, MADV_HUGEPAGE) == 0;
+        #else
+            (void)p;
+            (void)bytes;
+            return false;
+        #endif
+    }
+}
@@ -0,0 +1,154 @@
+/*
+ *  lowrank.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/SVD>
+
+namespace math {
+    // config for the low rank factorization of the weight matrices
+    typedef struct lowRank {
+        // fixed rank of the factorization, if 0 the rank is chosen by energy
+        size_t rank = 0;
+        // smallest fraction of the squared singular values (energy) that has to be kept
+        double energy = 0.99;
+        // factorize hweights and/or oweights
+        bool hidden = true;
+        bool output = true;
+    } lowRank;
+
+    /// <summary>
+    /// weight matrix W (rows x cols) of one layer, either dense or as truncated SVD W ~ U * V
+    /// with U (rows x rank) and V (rank x cols)
+    /// </summary>
+    typedef struct factoredLayer {
+        typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> matrix_type;
+
+        factoredLayer()
+            : rows(0), cols(0), rank(0), energy(1), factored(false) {}
+
+        /// <summary>
+        /// keep the dense row-major matrix w
+        /// </summary>
+        factoredLayer(const double* w, size_t _rows, size_t _cols)
+            : W(Eigen::Map<const matrix_type>(w, _rows, _cols)),
+            rows(_rows), cols(_cols), rank(std::min(_rows, _cols)), energy(1), factored(false) {}
+
+        /// <summary>
+        /// factorize the dense row-major matrix w. The factorization is only kept if it needs
+        /// fewer multiplications than the dense matrix.
+        /// </summary>
+        factoredLayer(const double* w, size_t _rows, size_t _cols, const lowRank& config)
+            : factoredLayer(w, _rows, _cols) {
+            Eigen::BDCSVD<Eigen::MatrixXd> svd(W, Eigen::ComputeThinU | Eigen::ComputeThinV);
+            const Eigen::VectorXd& sigma = svd.singularValues();
+            const double total = sigma.squaredNorm();
+
+            size_t k = config.rank;
+            if (k == 0) {
+                double kept = 0;
+                while (k < (size_t)sigma.size() && (total == 0 || kept < config.energy * total)) {
+                    kept += sigma[k] * sigma[k];
+                    ++k;
+                }
+                k = std::max<size_t>(k, 1);
+            }
+            k = std::min<size_t>(k, sigma.size());
+            if (k * (rows + cols) >= rows * cols)
+                return;
+
+            U = svd.matrixU().leftCols(k) * sigma.head(k).asDiagonal();
+            V = svd.matrixV().leftCols(k).transpose();
+            W.resize(0, 0);
+            rank = k;
+            energy = total > 0 ? sigma.head(k).squaredNorm() / total : 1;
+            factored = true;
+            tmp.resize(k);
+        }
+
+        /// <summary>
+        /// y = W * x, as two thin products if factored
+        /// </summary>
+        void apply(const double* x, double* y) const {
+            Eigen::Map<const Eigen::VectorXd> xv(x, cols);
+            Eigen::Map<Eigen::VectorXd> yv(y, rows);
+            if (factored) {
+                tmp.noalias() = V * xv;
+                yv.noalias() = U * tmp;
+            } else {
+                yv.noalias() = W * xv;
+            }
+        }
+
+        /// <summary>
+        /// multiplications per matrix-vector product
+        /// </summary>
+        size_t flops() const {
+            return factored ? rank * (rows + cols) : rows * cols;
+        }
+
+        /// <summary>
+        /// factors or dense matrix
+        /// </summary>
+        matrix_type U, V, W;
+        mutable Eigen::VectorXd tmp;
+
+        /// <summary>
+        /// dimensions, kept rank and kept fraction of the energy
+        /// </summary>
+        size_t rows, cols, rank;
+        double energy;
+        bool factored;
+    } factoredLayer;
+
+    /// <summary>
+    /// inference-only copy of a network with low rank hidden and/or output weights
+    /// (see supervisor::factorize)
+    /// </summary>
+    typedef struct lowRankNN {
+        lowRankNN()
+            : ninputs(0), noutputs(0), nneurons(0) {}
+
+        /// <summary>
+        /// dense parameters of the input layer and the thresholds
+        /// </summary>
+        std::vector<double> iweights, itheta, htheta, otheta;
+
+        /// <summary>
+        /// (factorized) weight matrices
+        /// </summary>
+        factoredLayer hweights, oweights;
+
+        /// <summary>
+        /// scratch buffers of the forward pass
+        /// </summary>
+        mutable std::vector<double> ioutput, houtput;
+
+        /// <summary>
+        /// number of inputs, outputs and neurons
+        /// </summary>
+        size_t ninputs, noutputs, nneurons;
+    } lowRankNN;
+
+    /// <summary>
+    /// result of the factorization of one layer
+    /// </summary>
+    typedef struct lowRankReport {
+        // name of the layer ("hidden" or "output")
+        std::string layer;
+        // dimensions of the weight matrix and the kept rank
+        size_t rows = 0, cols = 0, rank = 0;
+        // kept fraction of the energy
+        double energy = 1;
+        // loss on the given dataset of the dense network and with only this layer factorized
+        double denseLoss = 0, factoredLoss = 0;
+        // measured time of one matrix-vector product (ms) and the ratio dense / factored
+        double denseTime = 0, factoredTime = 0, speedup = 1;
+    } lowRankReport;
+}
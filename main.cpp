@@ -8,15 +8,13 @@
 #include <Eigen/Dense>
 #include <Eigen/StdVector>
 
+#include "modelfile.h"
 #include "nn.h"
 
 int main(int argc, char* args[]) {
     Eigen::initParallel();
     Eigen::setNbThreads(4);
 
-    // initialize random numbers
-    srand((unsigned int)time(NULL));
-
     math::config myconfig;
     myconfig.adaptive.apply = true;
 
@@ -78,6 +76,10 @@ int main(int argc, char* args[]) {
     dataset.push_back(d);*/
     math::supervisor::train(nn, dataset, 0.001, 15);
 
+    // save the trained model for the predict tool
+    if (argc > 1 && !math::modelFile::save(nn, args[1]))
+        std::cerr << "cannot save the model to " << args[1] << std::endl;
+
     // test
     math::vector<double> x1({0, 0, 0, 0});
     math::supervisor::calculateNN(x1, nn);
@@ -0,0 +1,147 @@
+/*
+ *  modelfile.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include "nn.h"
+
+namespace math {
+    /// <summary>
+    /// binary model files: the magic "SNN2", the transfer function (uint8, see transfer),
+    /// ninputs, noutputs and nneurons as uint64, the approximation config (uint8 apply, double
+    /// maxError) and the parameter blocks as doubles in the byte order of the machine. The blocks
+    /// are written back to back without the padding of nn.parameters, so the files do not depend
+    /// on the layout in memory.
+    /// </summary>
+    class modelFile {
+        public:
+            // transfer functions the library can be built with (see nn.h)
+            enum transfer { sigmoid = 1, relu = 2, tanh = 3, combined = 4 };
+
+            // largest number of inputs, outputs or neurons and of parameters load accepts
+            static constexpr uint64_t maxDimension = uint64_t(1) << 24;
+            static constexpr uint64_t maxParameters = uint64_t(1) << 31;
+            // smallest maxError of the approximated transfer functions load accepts, the table of
+            // a sigmoid has about 10^7 entries at this error
+            static constexpr double minMaxError = 1e-12;
+
+            /// <summary>
+            /// transfer function of this build
+            /// </summary>
+            static transfer builtTransfer() {
+                #if defined(RELU)
+                    return relu;
+                #elif defined(TANH)
+                    return tanh;
+                #elif defined(COMBINED)
+                    return combined;
+                #else
+                    return sigmoid;
+                #endif
+            }
+
+            static bool save(const nn& nn, std::ostream& os) {
+                os.write(magic, 4);
+                write<uint8_t>(os, builtTransfer());
+                write<uint64_t>(os, nn.ninputs);
+                write<uint64_t>(os, nn.noutputs);
+                write<uint64_t>(os, nn.nneurons);
+                write<uint8_t>(os, nn.cconfig.approx.apply);
+                write<double>(os, nn.cconfig.approx.maxError);
+                const double* p = nn.parameters.data();
+                for (const auto& b : blocks(nn.layout))
+                    os.write(reinterpret_cast<const char*>(p + b.first), b.second * sizeof(double));
+                return (bool)os;
+            }
+
+            static bool save(const nn& nn, const std::string& path) {
+                std::ofstream os(path, std::ios::binary);
+                return os && save(nn, os);
+            }
+
+            /// <summary>
+            /// read a model, returns nullptr if the stream does not hold a complete model, the
+            /// model was trained with another transfer function, its sizes exceed maxDimension or
+            /// maxParameters, its maxError is not finite or below minMaxError or it does not fit
+            /// into memory
+            /// </summary>
+            static std::unique_ptr<nn> load(std::istream& is) {
+                char header[4];
+                uint8_t function = 0;
+                uint64_t ninputs = 0, noutputs = 0, nneurons = 0;
+                uint8_t apply = 0;
+                double maxError = 0;
+                if (!is.read(header, 4) || std::memcmp(header, magic, 4) != 0)
+                    return nullptr;
+                if (!read(is, function) || function != builtTransfer())
+                    return nullptr;
+                if (!read(is, ninputs) || !read(is, noutputs) || !read(is, nneurons) || !read(is, apply) || !read(is, maxError))
+                    return nullptr;
+                if (ninputs == 0 || noutputs == 0 || nneurons == 0)
+                    return nullptr;
+                // the products cannot overflow once every size is bounded
+                if (ninputs > maxDimension || noutputs > maxDimension || nneurons > maxDimension)
+                    return nullptr;
+                if ((nneurons + 2) * ninputs + (noutputs + 1) * nneurons + noutputs > maxParameters)
+                    return nullptr;
+                // the size of the transfer tables follows from maxError
+                if (!std::isfinite(maxError) || !(maxError >= minMaxError))
+                    return nullptr;
+
+                config c;
+                c.approx.apply = apply != 0;
+                c.approx.maxError = maxError;
+                std::unique_ptr<nn> model;
+                try {
+                    model.reset(new nn(ninputs, noutputs, nneurons, c));
+                } catch (const std::bad_alloc&) {
+                    return nullptr;
+                }
+                double* p = model->parameters.data();
+                for (const auto& b : blocks(model->layout))
+                    if (!is.read(reinterpret_cast<char*>(p + b.first), b.second * sizeof(double)))
+                        return nullptr;
+                return model;
+            }
+
+            static std::unique_ptr<nn> load(const std::string& path) {
+                std::ifstream is(path, std::ios::binary);
+                return is ? load(is) : nullptr;
+            }
+
+        private:
+            static constexpr const char* magic = "SNN2";
+
+            /// <summary>
+            /// offset and length of every parameter block in the order of the file
+            /// </summary>
+            static std::array<std::pair<size_t, size_t>, 6> blocks(const parameterLayout& l) {
+                return { { { l.iweights, l.ninputs }, { l.itheta, l.ninputs }, { l.hweights, l.nneurons * l.ninputs },
+                    { l.htheta, l.nneurons }, { l.oweights, l.noutputs * l.nneurons }, { l.otheta, l.noutputs } } };
+            }
+
+            template<typename T>
+            static void write(std::ostream& os, T value) {
+                os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+            }
+
+            template<typename T>
+            static bool read(std::istream& is, T& value) {
+                return (bool)is.read(reinterpret_cast<char*>(&value), sizeof(T));
+            }
+    };
+}
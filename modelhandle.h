@@ -0,0 +1,192 @@
+/*
+ *  modelhandle.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nn.h"
+
+namespace math {
+    /// <summary>
+    /// handle to the live model of an inference process that can be replaced while readers are
+    /// running (epoch based reclamation). A reader announces the current epoch in its slot and
+    /// loads the model pointer; publish swaps the pointer and retires the old model, which is
+    /// deleted once every reader has left the epoch it was retired in. Readers never lock,
+    /// publishers are serialized by a mutex.
+    /// </summary>
+    class modelHandle {
+            static constexpr uint64_t idle = UINT64_MAX;
+
+            /// <summary>
+            /// slot of one reader: the epoch it announced, idle while it holds no snapshot.
+            /// One cache line per slot, so readers do not share lines.
+            /// </summary>
+            typedef struct alignas(64) readerSlot {
+                std::atomic<uint64_t> epoch{ idle };
+                std::atomic<bool> claimed{ false };
+            } readerSlot;
+
+        public:
+            /// <summary>
+            /// model together with its version number (1 for the first model)
+            /// </summary>
+            typedef struct version {
+                std::unique_ptr<const nn> model;
+                uint64_t number;
+            } version;
+
+            /// <summary>
+            /// a stable view of the live model, valid until the snapshot is destroyed
+            /// </summary>
+            class snapshot {
+                public:
+                    snapshot(snapshot&& other)
+                        : slot(other.slot), current(other.current) {
+                        other.slot = nullptr;
+                    }
+
+                    ~snapshot() {
+                        if (slot)
+                            slot->epoch.store(idle, std::memory_order_release);
+                    }
+
+                    snapshot(const snapshot&) = delete;
+                    snapshot& operator=(const snapshot&) = delete;
+
+                    const nn& model() const {
+                        return *current->model;
+                    }
+
+                    uint64_t number() const {
+                        return current->number;
+                    }
+
+                private:
+                    friend class modelHandle;
+
+                    snapshot(readerSlot* _slot, const version* _current)
+                        : slot(_slot), current(_current) {}
+
+                    readerSlot* slot;
+                    const version* current;
+            };
+
+            /// <summary>
+            /// a reader thread. Every reader owns one slot of the handle, so at most maxReaders
+            /// readers can exist at the same time, and holds at most one snapshot at a time.
+            /// </summary>
+            class reader {
+                public:
+                    reader(modelHandle& _handle)
+                        : handle(_handle), slot(_handle.claim()) {}
+
+                    ~reader() {
+                        slot->claimed.store(false, std::memory_order_release);
+                    }
+
+                    reader(const reader&) = delete;
+                    reader& operator=(const reader&) = delete;
+
+                    /// <summary>
+                    /// snapshot of the live model: one store and two loads, no lock
+                    /// </summary>
+                    snapshot read() {
+                        slot->epoch.store(handle.epoch.load());
+                        return snapshot(slot, handle.live.load());
+                    }
+
+                private:
+                    modelHandle& handle;
+                    readerSlot* slot;
+            };
+
+            modelHandle(std::unique_ptr<const nn> model, size_t maxReaders = 64)
+                : slots(maxReaders), live(new version{ std::move(model), 1 }), epoch(0) {}
+
+            ~modelHandle() {
+                delete live.load();
+                for (auto& r : retired)
+                    delete r.first;
+            }
+
+            modelHandle(const modelHandle&) = delete;
+            modelHandle& operator=(const modelHandle&) = delete;
+
+            /// <summary>
+            /// make model the live model, readers see it with their next read. Old models that
+            /// are not read any more are deleted. Returns the new version number.
+            /// </summary>
+            uint64_t publish(std::unique_ptr<const nn> model) {
+                std::unique_lock<std::mutex> lock(mutex);
+                const uint64_t number = live.load()->number + 1;
+                const version* old = live.exchange(new version{ std::move(model), number });
+                retired.emplace_back(old, epoch.fetch_add(1));
+                reclaimLocked();
+                return number;
+            }
+
+            /// <summary>
+            /// publish a fresh copy of the network
+            /// </summary>
+            uint64_t publish(const nn& model) {
+                return publish(std::unique_ptr<const nn>(new nn(model)));
+            }
+
+            /// <summary>
+            /// delete the retired models that are not read any more, returns the number of
+            /// retired models that are still in use
+            /// </summary>
+            size_t reclaim() {
+                std::unique_lock<std::mutex> lock(mutex);
+                reclaimLocked();
+                return retired.size();
+            }
+
+        private:
+            /// <summary>
+            /// a model retired in epoch e can be read by readers that announced an epoch <= e
+            /// </summary>
+            void reclaimLocked() {
+                uint64_t oldest = idle;
+                for (const auto& s : slots)
+                    oldest = std::min(oldest, s.epoch.load());
+                auto it = std::remove_if(retired.begin(), retired.end(), [oldest](const std::pair<const version*, uint64_t>& r) {
+                    if (r.second >= oldest)
+                        return false;
+                    delete r.first;
+                    return true;
+                });
+                retired.erase(it, retired.end());
+            }
+
+            readerSlot* claim() {
+                for (;;) {
+                    for (auto& s : slots) {
+                        bool expected = false;
+                        if (!s.claimed.load(std::memory_order_relaxed) && s.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                            return &s;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+
+            std::vector<readerSlot> slots;
+            std::atomic<const version*> live;
+            std::atomic<uint64_t> epoch;
+
+            /// <summary>
+            /// retired models and the epoch they were retired in
+            /// </summary>
+            std::vector<std::pair<const version*, uint64_t>> retired;
+            std::mutex mutex;
+    };
+}
@@ -5,12 +5,33 @@
  */
 
 #pragma once
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <atomic>
+#include <memory>
+#include <new>
 #include <vector>
+#include <Eigen/Dense>
 
 #include "vector.h"
 #include "matrix.h"
 #include "operators.h"
+#include "accounting.h"
+#include "activation.h"
+#include "codegen.h"
+#include "dispatch.h"
+#include "evaluation.h"
+#include "graph.h"
+#include "layout.h"
+#include "lowrank.h"
+#include "random.h"
+#include "sampling.h"
+#include "sparse.h"
+#include "threadpool.h"
+#include "workspace.h"
 
 // choose transfer function
 #define SIGMOID
@@ -30,6 +51,81 @@ namespace math {
         mutable int nAdapt = 0;
     } adaptive;
 
+    // config for the parameter initialization
+    typedef struct initialization {
+        // zero: all parameters 0
+        // uniform: all parameters uniformly in [-1, 1)
+        // xavier: Glorot uniform, limit sqrt(6 / (fanin + fanout)), for sigmoid and tanh
+        // he: He uniform, limit sqrt(6 / fanin), for relu
+        enum scheme { zero, uniform, xavier, he };
+        #ifdef RELU
+            scheme method = he;
+        #else
+            scheme method = xavier;
+        #endif
+        uint64_t seed = 5489;
+    } initialization;
+
+    // config for the approximated transfer functions (if used)
+    typedef struct approximation {
+        bool apply = false;
+        // guaranteed maximal absolute error of the approximated transfer functions
+        double maxError = 1e-4;
+        // tables of the input/hidden and the output layer, built by nn.
+        // relu is exact and cheap and is never tabulated.
+        mutable std::shared_ptr<const transferTable> inner, outer;
+
+        void build() const {
+            if (!apply)
+                return;
+            #ifdef SIGMOID
+                inner = outer = std::make_shared<const transferTable>(transferTable::sigmoid(maxError));
+            #endif
+            #ifdef TANH
+                inner = outer = std::make_shared<const transferTable>(transferTable::tanh(maxError));
+            #endif
+            #ifdef COMBINED
+                inner = std::make_shared<const transferTable>(transferTable::sigmoid(maxError));
+            #endif
+        }
+    } approximation;
+
+    // config for frozen layers (if used): the parameters of a frozen layer are not updated by
+    // training. If the input and the hidden layer are frozen, train caches the hidden activations
+    // of every sample once and only runs the output layer.
+    typedef struct freezing {
+        // iweights and itheta
+        bool input = false;
+        // hweights and htheta
+        bool hidden = false;
+        // oweights and otheta
+        bool output = false;
+    } freezing;
+
+    // config for loss-prioritized sampling (if used): train draws mini-batches with probability
+    // proportional to the last known loss of every sample and weights each drawn sample by
+    // 1 / (batch * probability), so the expected gradient equals the gradient of the whole dataset
+    typedef struct sampling {
+        bool apply = false;
+        // samples per mini-batch
+        size_t batch = 32;
+        // samples with a loss below this are solved and not drawn until the next refresh
+        double solved = 1e-3;
+        // the losses of all samples are recomputed every refresh steps
+        size_t refresh = 50;
+        // every unsolved sample gets smoothing times the mean loss added to its priority. Bounds
+        // the weight of samples with a small loss (0: purely loss proportional, large: uniform)
+        double smoothing = 1;
+        uint64_t seed = 5489;
+    } sampling;
+
+    // config for the memory of the parameters
+    typedef struct memory {
+        // back the parameters with transparent huge pages (Linux only, pays off from a few MB of
+        // parameters on): fewer TLB misses when training sweeps over all of them
+        bool hugePages = false;
+    } memory;
+
     /// <summary>
     /// configuration of the neural net
     /// </summary>
@@ -41,6 +137,11 @@ namespace math {
             : adaptive(_adaptive) {}
 
         adaptive adaptive;
+        initialization init;
+        approximation approx;
+        freezing freeze;
+        sampling sample;
+        memory mem;
     } config;
 
     /// <summary>
@@ -48,53 +149,129 @@ namespace math {
     /// </summary>
     typedef struct nn {
         nn(size_t _ninputs, size_t _noutputs, size_t _nneurons, const config _config = config())
-            : parameters(2*_ninputs + _ninputs * _nneurons + _nneurons + _nneurons * _noutputs + _noutputs),
+            : layout(_ninputs, _noutputs, _nneurons),
+            parameters(layout.size),
             
-            iweights(parameters.data(), _ninputs, 1), 
-            itheta(parameters.data() + _ninputs, _ninputs, 1),
+            iweights(parameters.data() + layout.iweights, _ninputs, 1), 
+            itheta(parameters.data() + layout.itheta, _ninputs, 1),
             ioutput(_ninputs, 0),
 
-            hweights(parameters.data() + 2 * _ninputs, _nneurons, _ninputs),
-            htheta(parameters.data() +  2 * _ninputs + _nneurons * _ninputs, _nneurons, 1),
+            hweights(parameters.data() + layout.hweights, _nneurons, _ninputs),
+            htheta(parameters.data() + layout.htheta, _nneurons, 1),
             houtput(_nneurons, 0),
 
-            oweights(parameters.data() + 2 * _ninputs + _nneurons * _ninputs + _nneurons, _noutputs, _nneurons),
-            otheta(parameters.data() + 2 * _ninputs + _nneurons * _ninputs + _nneurons + _noutputs * _nneurons, _noutputs, 1),
+            oweights(parameters.data() + layout.oweights, _noutputs, _nneurons),
+            otheta(parameters.data() + layout.otheta, _noutputs, 1),
             ooutput(_noutputs, 0),
 
-            ntotparameters(2*_ninputs + _ninputs * _nneurons + _nneurons + _nneurons * _noutputs + _noutputs),
+            ntotparameters(layout.size),
             ninputs(_ninputs), noutputs(_noutputs), nneurons(_nneurons),
 
-            cconfig(_config) {}
+            cconfig(_config) {
+            cconfig.approx.build();
+            if (cconfig.mem.hugePages)
+                adviseHugePages(parameters.data(), ntotparameters * sizeof(double));
+        }
 
         /// <summary>
-        /// all parameters of the network
+        /// deep copy, the views point into the parameters of the copy. The tables of the
+        /// approximated transfer functions are immutable and shared.
+        /// </summary>
+        nn(const nn& other)
+            : layout(other.layout),
+            parameters(other.parameters),
+
+            iweights(parameters.data() + layout.iweights, other.ninputs, 1),
+            itheta(parameters.data() + layout.itheta, other.ninputs, 1),
+            ioutput(other.ioutput),
+
+            hweights(parameters.data() + layout.hweights, other.nneurons, other.ninputs),
+            htheta(parameters.data() + layout.htheta, other.nneurons, 1),
+            houtput(other.houtput),
+
+            oweights(parameters.data() + layout.oweights, other.noutputs, other.nneurons),
+            otheta(parameters.data() + layout.otheta, other.noutputs, 1),
+            ooutput(other.ooutput),
+
+            ntotparameters(other.ntotparameters),
+            ninputs(other.ninputs), noutputs(other.noutputs), nneurons(other.nneurons),
+
+            cconfig(other.cconfig) {
+            if (cconfig.mem.hugePages)
+                adviseHugePages(parameters.data(), ntotparameters * sizeof(double));
+        }
+
+        /// <summary>
+        /// takes over the parameters of other, the views are rebound to them. other is left
+        /// with empty parameters and views and may only be destroyed.
+        /// </summary>
+        nn(nn&& other)
+            : layout(other.layout),
+            parameters(std::move(other.parameters)),
+
+            iweights(parameters.data() + layout.iweights, other.ninputs, 1),
+            itheta(parameters.data() + layout.itheta, other.ninputs, 1),
+            ioutput(std::move(other.ioutput)),
+
+            hweights(parameters.data() + layout.hweights, other.nneurons, other.ninputs),
+            htheta(parameters.data() + layout.htheta, other.nneurons, 1),
+            houtput(std::move(other.houtput)),
+
+            oweights(parameters.data() + layout.oweights, other.noutputs, other.nneurons),
+            otheta(parameters.data() + layout.otheta, other.noutputs, 1),
+            ooutput(std::move(other.ooutput)),
+
+            ntotparameters(other.ntotparameters),
+            ninputs(other.ninputs), noutputs(other.noutputs), nneurons(other.nneurons),
+
+            cconfig(other.cconfig) {
+            // the views of other still point into the parameters taken over, a map can only be
+            // rebound by constructing it again
+            new (&other.iweights) vector<double>::map_type(nullptr, 0, 1);
+            new (&other.itheta) vector<double>::map_type(nullptr, 0, 1);
+            new (&other.hweights) matrix<double>::map_type(nullptr, 0, 0);
+            new (&other.htheta) vector<double>::map_type(nullptr, 0, 1);
+            new (&other.oweights) matrix<double>::map_type(nullptr, 0, 0);
+            new (&other.otheta) vector<double>::map_type(nullptr, 0, 1);
+        }
+
+        // the shape and the config of a network are fixed, copy the parameters instead
+        nn& operator=(const nn&) = delete;
+        nn& operator=(nn&&) = delete;
+
+        /// <summary>
+        /// offsets of the parameter blocks, every block starts on a cache line
+        /// </summary>
+        const parameterLayout layout;
+
+        /// <summary>
+        /// all parameters of the network, the padding between the blocks stays zero
         /// </summary>
         vector<double> parameters;
         
         /// <summary>
         /// parameters of the input neurons
         /// </summary>
-        vector<double>::map_type iweights; // mat[NINPUTS] -> par(0, ninputs)
-        vector<double>::map_type itheta;   // mat[NINPUTS] -> par(ninputs, ninputs + ninputs)
+        vector<double>::map_type iweights; // mat[NINPUTS] -> par(layout.iweights, layout.iweights + ninputs)
+        vector<double>::map_type itheta;   // mat[NINPUTS] -> par(layout.itheta, layout.itheta + ninputs)
         mutable vector<double> ioutput;    // mat[NINPUTS]
         
         /// <summary>
         /// parameters of the fully connected, inner neurons (hidden layer)
         /// </summary>
-        matrix<double>::map_type hweights; // mat[NNEURONS][NINPUTS] -> par(2 * ninputs, 2 * ninputs + nneurons * ninputs)
-        vector<double>::map_type htheta;   // mat[NNEURONS] -> par(2 * ninputs + nneurons * ninputs, 2 * ninputs + nneurons * ninputs + nneurons)
+        matrix<double>::map_type hweights; // mat[NNEURONS][NINPUTS] -> par(layout.hweights, layout.hweights + nneurons * ninputs)
+        vector<double>::map_type htheta;   // mat[NNEURONS] -> par(layout.htheta, layout.htheta + nneurons)
         mutable vector<double> houtput;    // mat[NNEURONS]
         
         /// <summary>
         /// parameters of the output neurons
         /// </summary>
-        matrix<double>::map_type oweights; // mat[NOUTPUTS][NNEURONS] -> par(2 * ninputs + nneurons * ninputs + nneurons, 2 * ninputs + nneurons * ninputs + nneurons + noutputs * nneurons)
-        vector<double>::map_type otheta;   // mat[NOUTPUTS] -> par(2 * ninputs + nneurons * ninputs + nneurons + noutputs * nneurons, 2 * ninputs + nneurons * ninputs + nneurons + noutputs * nneurons + noutputs)
+        matrix<double>::map_type oweights; // mat[NOUTPUTS][NNEURONS] -> par(layout.oweights, layout.oweights + noutputs * nneurons)
+        vector<double>::map_type otheta;   // mat[NOUTPUTS] -> par(layout.otheta, layout.otheta + noutputs)
         mutable vector<double> ooutput;    // mat[NOUTPUTS]
 
         /// <summary>
-        /// number of total parameters, number of inputs, outputs and neurons
+        /// number of total parameters (including the padding), number of inputs, outputs and neurons
         /// </summary>
         const size_t ntotparameters, ninputs, noutputs, nneurons;
 
@@ -104,6 +281,58 @@ namespace math {
         const config cconfig;
     } nn;
 
+    /// <summary>
+    /// copy-on-write handle to a network. Copies of a handle (clone) share one network until one
+    /// of them asks for write access, which gives it a private deep copy first. Snapshots,
+    /// ensemble members and per-thread replicas of a model are therefore cheap until they diverge.
+    /// A handle must only be used by one thread at a time, different clones by different threads.
+    /// Shared networks must be evaluated with a workspace (calculateNN(xx, nn, ws)), because
+    /// calculateNN(xx, nn) writes the activations of the network.
+    /// </summary>
+    class sharedNN {
+        public:
+            sharedNN(const nn& model)
+                : model(std::make_shared<nn>(model)) {}
+
+            sharedNN(nn&& model)
+                : model(std::make_shared<nn>(std::move(model))) {}
+
+            /// <summary>
+            /// handle that shares the network until either of both writes
+            /// </summary>
+            sharedNN clone() const {
+                return *this;
+            }
+
+            const nn& read() const {
+                return *model;
+            }
+
+            /// <summary>
+            /// network for writing, copied first if it is shared with another handle
+            /// </summary>
+            nn& write() {
+                if (model.use_count() > 1) {
+                    model = std::make_shared<nn>(static_cast<const nn&>(*model));
+                } else {
+                    // use_count is a relaxed load: synchronize with the release of the last other
+                    // handle, so its reads of the network happen before the writes of the caller
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                }
+                return *model;
+            }
+
+            /// <summary>
+            /// true if another handle shares the network
+            /// </summary>
+            bool shared() const {
+                return model.use_count() > 1;
+            }
+
+        private:
+            std::shared_ptr<nn> model;
+    };
+
     /// <summary>
     /// A dataset for given inputs and outputs
     /// </summary>
@@ -127,56 +356,165 @@ namespace math {
         const size_t ninputs, noutputs;
     } dataSet;
 
+    /// <summary>
+    /// A dataset with a sparse input (e.g. wide one-hot features) and dense outputs
+    /// </summary>
+    typedef struct sparseDataSet {
+        sparseDataSet(size_t _ninputs, size_t _noutputs)
+            : xx(_ninputs), yy(_noutputs) {}
+
+        sparseDataSet(const sparseVector& _xx, const math::vector<double>& _yy)
+            : xx(_xx), yy(_yy) {}
+
+        sparseVector xx;
+        math::vector<double> yy;
+    } sparseDataSet;
+
+    /// <summary>
+    /// K networks of the same shape whose parameters are stacked into one block, so that they
+    /// can be trained in lockstep (see supervisor::train(ensemble&, ...))
+    /// </summary>
+    typedef struct ensemble {
+        ensemble(size_t _ninputs, size_t _noutputs, size_t _nneurons, size_t _nmembers, const config _config = config())
+            : layout(_ninputs, _noutputs, _nneurons),
+            parameters(_nmembers * layout.size),
+            adaptives(_nmembers, _config.adaptive), losses(_nmembers, INFINITY), scratch(_nmembers),
+            nparameters(layout.size),
+            ninputs(_ninputs), noutputs(_noutputs), nneurons(_nneurons), nmembers(_nmembers),
+            cconfig(_config) {
+            cconfig.approx.build();
+        }
+
+        /// <summary>
+        /// parameters of member k, in the same layout as nn.parameters
+        /// </summary>
+        double* member(size_t k) {
+            return parameters.data() + k * nparameters;
+        }
+
+        const double* member(size_t k) const {
+            return parameters.data() + k * nparameters;
+        }
+
+        /// <summary>
+        /// buffers of one member for a block of samples (one column per sample)
+        /// </summary>
+        typedef struct buffers {
+            Eigen::MatrixXd xx, yy, ioutput, houtput, ooutput, idelta, hdelta, odelta;
+        } buffers;
+
+        /// <summary>
+        /// offsets of the parameter blocks of every member, the same as in nn
+        /// </summary>
+        const parameterLayout layout;
+
+        /// <summary>
+        /// parameters of all members, member k at k * nparameters
+        /// </summary>
+        std::vector<double> parameters;
+
+        /// <summary>
+        /// state of the adaptive learning rate and last loss of every member
+        /// </summary>
+        std::vector<adaptive> adaptives;
+        std::vector<double> losses;
+
+        /// <summary>
+        /// scratch buffers of every member
+        /// </summary>
+        mutable std::vector<buffers> scratch;
+
+        /// <summary>
+        /// number of parameters per member, number of inputs, outputs, neurons and members
+        /// </summary>
+        const size_t nparameters, ninputs, noutputs, nneurons, nmembers;
+
+        /// <summary>
+        /// config that is used to work on the ensemble
+        /// </summary>
+        const config cconfig;
+    } ensemble;
+
     /// <summary>
     /// Supervisor that trains the network
     /// </summary>
     class supervisor {
         public:
             /// <summary>
-            /// reset all parameters
+            /// reset all parameters according to nn.cconfig.init
             /// </summary>
             static void init(nn& nn) {
-                for (int i = 0; i < nn.ntotparameters; ++i)
-                    nn.parameters[i] = 0; //rnd(0, 1);
+                init(nn, nn.cconfig.init.seed);
             }
 
             /// <summary>
-            /// calculate the outputs for a given input
+            /// reset all parameters according to nn.cconfig.init with the given seed.
+            /// The parameters are filled in fixed blocks, each block with its own generator
+            /// stream, so the result only depends on the seed and not on the number of threads.
             /// </summary>
-            static void calculateNN(const math::vector<double>& xx, const nn& nn) {
-                // TODO: put this into the config struct
-                #ifdef SIGMOID
-                    double (&func)(double) = unarySigmoid;
-                #endif
+            static void init(nn& nn, uint64_t seed) {
+                const initialization::scheme method = nn.cconfig.init.method;
+                const size_t hbegin = hweightsOffset(nn);
+                const size_t hend = hbegin + nn.nneurons * nn.ninputs;
+                const size_t obegin = oweightsOffset(nn);
+                const size_t oend = obegin + nn.noutputs * nn.nneurons;
+                const double hlimit = initLimit(method, nn.ninputs, nn.nneurons);
+                const double olimit = initLimit(method, nn.nneurons, nn.noutputs);
 
-                #ifdef RELU
-                    double (&func)(double) = unaryRelu;
-                #endif
+                auto fill = [&](size_t first, size_t last) {
+                    for (size_t b = first; b < last; ++b) {
+                        random::xoshiro256 gen(seed, b);
+                        const size_t end = std::min((b + 1) * initBlockSize, nn.ntotparameters);
+                        for (size_t i = b * initBlockSize; i < end; ++i) {
+                            double& p = nn.parameters[i];
+                            if (method == initialization::zero || nn.layout.padding(i))
+                                p = 0;
+                            else if (method == initialization::uniform)
+                                p = rnd(gen, -1, 1);
+                            else if (i < nn.ninputs)
+                                p = 1; // input layer: start as identity scaling
+                            else if (i >= hbegin && i < hend)
+                                p = rnd(gen, -hlimit, hlimit);
+                            else if (i >= obegin && i < oend)
+                                p = rnd(gen, -olimit, olimit);
+                            else
+                                p = 0; // thresholds
+                        }
+                    }
+                };
 
-                #ifdef TANH
-                    double (&func)(double) = unaryTanh;
-                #endif
+                const size_t nblocks = (nn.ntotparameters + initBlockSize - 1) / initBlockSize;
+                if (nblocks < 4)
+                    fill(0, nblocks);
+                else
+                    threadPool::shared().parallelFor(0, nblocks, [&](size_t first, size_t last, size_t) { fill(first, last); });
+            }
 
+            /// <summary>
+            /// calculate the outputs for a given input
+            /// </summary>
+            static void calculateNN(const math::vector<double>& xx, const nn& nn) {
+                // TODO: put this into the config struct
                 #if defined(SIGMOID) || defined(RELU) || defined(TANH)
                     nn.ioutput = math::eigen::cprod(nn.iweights, xx) - nn.itheta;
-                    nn.ioutput = math::eigen::unary(nn.ioutput, &func);
+                    activateInner(nn.cconfig, nn.ioutput.data(), nn.ninputs);
 
                     nn.houtput = nn.hweights * nn.ioutput - nn.htheta;
-                    nn.houtput = math::eigen::unary(nn.houtput, &func);
+                    activateInner(nn.cconfig, nn.houtput.data(), nn.nneurons);
 
                     nn.ooutput = nn.oweights * nn.houtput - nn.otheta;
-                    nn.ooutput = math::eigen::unary(nn.ooutput, &func);
+                    activateOuter(nn.cconfig, nn.ooutput.data(), nn.noutputs);
                 #endif
 
                 #ifdef COMBINED
                     nn.ioutput = math::eigen::cprod(nn.iweights, xx) - nn.itheta;
-                    nn.ioutput = math::eigen::unary(nn.ioutput, &unarySigmoid);
+                    activateInner(nn.cconfig, nn.ioutput.data(), nn.ninputs);
 
                     nn.houtput = nn.hweights * nn.ioutput - nn.htheta;
-                    nn.houtput = math::eigen::unary(nn.houtput, &unarySigmoid);
+                    activateInner(nn.cconfig, nn.houtput.data(), nn.nneurons);
 
                     nn.ooutput = nn.oweights * nn.houtput + nn.otheta;
-                    nn.ooutput = math::eigen::unary(nn.ooutput, &unaryRelu);
+                    activateOuter(nn.cconfig, nn.ooutput.data(), nn.noutputs);
                 #endif
             }
 
@@ -184,57 +522,475 @@ namespace math {
             /// train the network (gradient descent method)
             /// </summary>
             static void train(nn& nn, const std::vector<dataSet>& dataset, const double accuracy, const double learningrate) {
-                double h = 0.005;
-                math::vector<double> deriv(nn.ntotparameters);
+                train(nn, dataset, accuracy, learningrate, math::vector<double>(nn.ntotparameters, 1));
+            }
+
+            /// <summary>
+            /// train the network, only parameters with mask[i] != 0 are updated
+            /// (e.g. fine-tuning after prune, pruned weights stay zero)
+            /// </summary>
+            static void train(nn& nn, const std::vector<dataSet>& dataset, const double accuracy, const double learningrate, const math::vector<double>& mask) {
+                const freezing& freeze = nn.cconfig.freeze;
+                if (freeze.input && freeze.hidden && freeze.output)
+                    return;
+                const bool cached = freeze.input && freeze.hidden;
+                if (nn.cconfig.sample.apply && !cached) {
+                    trainSampled(nn, dataset, accuracy, learningrate, mask);
+                    return;
+                }
+                workspace ws = createWorkspace(nn);
+                frozenCache cache = cached ? cacheFrozen(nn, dataset) : frozenCache();
                 size_t counter = 0;
                 // optimize the cost function
                 double lf = 0;
                 do {
-                    lf = lossFunction(nn, dataset);
-
-                    for (int i = 0; i < nn.ntotparameters; ++i) {
-                        double tempi = nn.parameters[i];
-                        nn.parameters[i] = nn.parameters[i] + h;
-                        double lfi = lossFunction(nn, dataset);
-                        //std::cout << "lf" << i << " = " << lf << std::endl;
-                        deriv[i] = (lfi - lf) / h;
-                        nn.parameters[i] = tempi;
+                    lf = cached ? step(nn, cache, learningrate, mask) : step(nn, dataset, learningrate, mask, ws);
+
+                    // Status
+                    if (counter++ % 100 == 0)
+                        std::cout << "lf  = " << lf << std::endl;
+                } while (lf > accuracy);
+            }
+
+            /// <summary>
+            /// train the network on loss-prioritized mini-batches (see sampling), only parameters
+            /// with mask[i] != 0 are updated. Every refresh steps the losses of all samples are
+            /// recomputed; training stops when their sum is at most accuracy. Solved samples are
+            /// skipped, so once most of the dataset is learned a step only costs the hard samples.
+            /// If every sample is solved but their sum is still above accuracy, all samples are
+            /// drawn by their last loss until the next refresh.
+            /// </summary>
+            static samplingReport trainSampled(nn& nn, const std::vector<dataSet>& dataset, const double accuracy, const double learningrate, const math::vector<double>& mask) {
+                const sampling& config = nn.cconfig.sample;
+                const size_t batch = std::max<size_t>(1, config.batch);
+                const size_t refresh = std::max<size_t>(1, config.refresh);
+                workspace ws = createWorkspace(nn);
+                prioritySampler sampler(dataset.size(), config.seed);
+                std::vector<size_t> drawn(batch);
+                std::vector<double> weights(batch), losses(dataset.size());
+                double offset = 0;
+                samplingReport report;
+                for (;;) {
+                    if (report.steps % refresh == 0) {
+                        report.loss = 0;
+                        double unsolvedLoss = 0;
+                        size_t nunsolved = 0;
+                        for (size_t i = 0; i < dataset.size(); ++i) {
+                            calculateNN(dataset[i].xx, nn, ws);
+                            losses[i] = std::sqrt(cpu::kernels().squaredDistance(ws.ooutput, dataset[i].yy.data(), nn.noutputs)) / 2;
+                            report.loss += losses[i];
+                            if (losses[i] >= config.solved) {
+                                unsolvedLoss += losses[i];
+                                ++nunsolved;
+                            }
+                        }
+                        report.forwards += dataset.size();
+                        offset = nunsolved ? config.smoothing * unsolvedLoss / nunsolved : 0;
+                        for (size_t i = 0; i < dataset.size(); ++i)
+                            sampler.set(i, losses[i] < config.solved ? 0 : losses[i] + offset);
+
+                        // Status
+                        if (report.steps % (100 * refresh) == 0)
+                            std::cout << "lf  = " << report.loss << std::endl;
+                        if (report.loss <= accuracy)
+                            break;
                     }
+                    if (sampler.total() <= 0) {
+                        for (size_t i = 0; i < dataset.size(); ++i)
+                            sampler.set(i, losses[i]);
+                        // every loss is zero, nothing left to learn
+                        if (sampler.total() <= 0)
+                            break;
+                    }
+
+                    // draw the whole batch before the priorities change, the unsolved samples
+                    // account for (almost) the whole loss
+                    const double total = sampler.total();
+                    for (size_t b = 0; b < batch; ++b) {
+                        drawn[b] = sampler.draw();
+                        weights[b] = total / (batch * sampler.priority(drawn[b]));
+                    }
+                    std::fill(ws.gradient, ws.gradient + nn.ntotparameters, 0.0);
+                    // importance weighted loss of the batch, estimates the loss of the drawable
+                    // samples for the adaptive learning rate
+                    double lf = 0;
+                    for (size_t b = 0; b < batch; ++b) {
+                        const double l = backpropagate(dataset[drawn[b]].xx, dataset[drawn[b]].yy, nn, ws, weights[b]);
+                        sampler.set(drawn[b], l < config.solved ? 0 : l + offset);
+                        losses[drawn[b]] = l;
+                        lf += weights[b] * l;
+                    }
+                    report.backwards += batch;
+                    update(nn, ws.gradient, lf, learningrate, mask);
+                    ++report.steps;
+                }
+                return report;
+            }
+
+            /// <summary>
+            /// buffers for calculateNN, gradient and step sized for the network
+            /// </summary>
+            static workspace createWorkspace(const nn& nn) {
+                return workspace(nn.ninputs, nn.noutputs, nn.nneurons, nn.ntotparameters);
+            }
+
+            /// <summary>
+            /// exact memory of the network and of training it on the dataset with train, and the
+            /// flops per sample of calculateNN and backpropagation
+            /// </summary>
+            static resourceReport resources(const nn& nn, const std::vector<dataSet>& dataset) {
+                const size_t ni = nn.ninputs, nh = nn.nneurons, no = nn.noutputs;
+                resourceReport r;
+                r.parameterBytes = nn.ntotparameters * sizeof(double);
+                r.activationBytes = (ni + nh + no) * sizeof(double);
+                r.workspaceBytes = (2 * (ni + nh + no) + nn.ntotparameters) * sizeof(double);
+                r.gradientBytes = nn.ntotparameters * sizeof(double);
+                r.optimizerBytes = nn.ntotparameters * sizeof(double) + sizeof(adaptive);
+                r.datasetBytes = dataset.capacity() * sizeof(dataSet);
+                for (const auto& d : dataset)
+                    r.datasetBytes += (d.xx.size() + d.yy.size()) * sizeof(double);
+
+                // weights: one multiplication and addition each, thresholds: one addition each
+                r.forwardFlops = 2 * (ni + nh * ni + no * nh) + ni + nh + no;
+                r.transfers = ni + nh + no;
+                // loss (3 per output and the root), deltas with derivatives, gradients of the
+                // weights (outer products) and thresholds, deltas propagated back (transposed products)
+                r.backwardFlops = 3 * no + 1
+                    + 5 * no + 2 * no * nh + no
+                    + 2 * no * nh + 3 * nh + 2 * nh * ni + nh
+                    + 2 * nh * ni + 3 * ni + 2 * ni + ni;
+                return r;
+            }
+
+            /// <summary>
+            /// one gradient descent step on the whole dataset, only parameters with mask[i] != 0
+            /// are updated. Returns the loss before the step. Does not allocate.
+            /// </summary>
+            static double step(nn& nn, const std::vector<dataSet>& dataset, const double learningrate, const math::vector<double>& mask, workspace& ws) {
+                const double lf = gradient(nn, dataset, ws);
+                update(nn, ws.gradient, lf, learningrate, mask);
+                return lf;
+            }
+
+            /// <summary>
+            /// gradient descent update with a given gradient (e.g. summed up over several workers)
+            /// and the loss it was computed at, only parameters with mask[i] != 0 are updated
+            /// </summary>
+            static void update(nn& nn, const double* gradient, const double lf, const double learningrate, const math::vector<double>& mask) {
+                // adapt the parameters of the layers that are not frozen
+                const double alpha = adaptLearningRate(nn.cconfig.adaptive, lf, learningrate);
+                const freezing& freeze = nn.cconfig.freeze;
+                const size_t bounds[4] = { 0, hweightsOffset(nn), oweightsOffset(nn), nn.ntotparameters };
+                const bool frozen[3] = { freeze.input, freeze.hidden, freeze.output };
+                for (int l = 0; l < 3; ++l)
+                    if (!frozen[l])
+                        cpu::kernels().update(nn.parameters.data() + bounds[l], alpha, mask.data() + bounds[l], gradient + bounds[l], bounds[l + 1] - bounds[l]);
+            }
+
+            /// <summary>
+            /// hidden activations of every sample of the dataset, valid as long as the input and
+            /// the hidden layer do not change (e.g. while they are frozen)
+            /// </summary>
+            static frozenCache cacheFrozen(const nn& nn, const std::vector<dataSet>& dataset) {
+                frozenCache cache(nn.noutputs, nn.nneurons, dataset.size());
+                workspace ws = createWorkspace(nn);
+                for (size_t s = 0; s < dataset.size(); ++s) {
+                    calculateNN(dataset[s].xx, nn, ws);
+                    std::copy(ws.houtput, ws.houtput + nn.nneurons, cache.houtput.col(s).data());
+                    for (size_t j = 0; j < nn.noutputs; ++j)
+                        cache.yy(j, s) = dataset[s].yy[j];
+                }
+                return cache;
+            }
+
+            /// <summary>
+            /// one gradient descent step of the output layer on the cached hidden activations,
+            /// all samples at once. Returns the loss before the step. Same result as
+            /// step(nn, dataset, ...) with frozen input and hidden layer.
+            /// </summary>
+            static double step(nn& nn, frozenCache& cache, const double learningrate, const math::vector<double>& mask) {
+                const size_t no = nn.noutputs, nh = nn.nneurons;
+                const double* otheta = nn.parameters.data() + othetaOffset(nn);
+                cache.ooutput.noalias() = oweightsMap(nn) * cache.houtput;
+
+                double lf = 0;
+                for (size_t s = 0; s < cache.nsamples; ++s) {
+                    double* o = cache.ooutput.col(s).data();
+                    for (size_t j = 0; j < no; ++j)
+                        o[j] += outerThetaSign * otheta[j];
+                    activateOuter(nn.cconfig, o, no);
 
-                    /*
-                    std::cout << "param = ";
-                    for(int i = 0; i < nn.ntotparameters; ++i)
-                         std::cout << nn.parameters[i] << " ";
-                    std::cout << std::endl;
-
-                    std::cout << "deriv = ";
-                    for(int i = 0; i < nn.ntotparameters; ++i)
-                         std::cout << deriv[i] << " ";
-                    std::cout << std::endl;
-                    */
-
-                    // adapt the parameters
-                    double alpha = learningrate;
-
-                    if (nn.cconfig.adaptive.apply) {
-                        auto& save = nn.cconfig.adaptive.save;
-                        auto& lowerThreshold = nn.cconfig.adaptive.lowerThreshold;
-                        auto& upperThreshold = nn.cconfig.adaptive.upperThreshold;
-                        auto& nAdapt = nn.cconfig.adaptive.nAdapt;
-                        auto& maxnAdapt = nn.cconfig.adaptive.maxnAdapt;
-                        auto& increase = nn.cconfig.adaptive.increase;
-                        // if there is only a small change in the lossfunction during
-                        // two subsequent iterations, increase the learning rate, else decrease it
-                        if(std::abs(lf - save) < lowerThreshold) nAdapt++;
-                        if(std::fabs(lf - save) > upperThreshold) nAdapt--;
-                        if (nAdapt < -maxnAdapt) nAdapt = -maxnAdapt;
-                        if (nAdapt > maxnAdapt) nAdapt = maxnAdapt;
-                        double fac = std::pow(1 + increase, nAdapt);
-                        alpha = alpha * fac;
-                        save = lf;
+                    // loss of the sample: |ooutput - yy| / 2
+                    const double delta = std::sqrt(cpu::kernels().squaredDistance(o, cache.yy.col(s).data(), no));
+                    lf += delta / 2;
+                    for (size_t j = 0; j < no; ++j)
+                        cache.odelta(j, s) = delta == 0 ? 0 : (o[j] - cache.yy(j, s)) / (2 * delta) * outerDerivative(o[j]);
+                }
+
+                // gradient of oweights and otheta, back to back without the padding of nn.parameters
+                Eigen::Map<rowMatrix>(cache.gradient.data(), no, nh).noalias() = cache.odelta * cache.houtput.transpose();
+                Eigen::Map<Eigen::VectorXd>(cache.gradient.data() + no * nh, no) = outerThetaSign * cache.odelta.rowwise().sum();
+
+                const double alpha = adaptLearningRate(nn.cconfig.adaptive, lf, learningrate);
+                const size_t ooffset = oweightsOffset(nn), otoffset = othetaOffset(nn);
+                cpu::kernels().update(nn.parameters.data() + ooffset, alpha, mask.data() + ooffset, cache.gradient.data(), no * nh);
+                cpu::kernels().update(nn.parameters.data() + otoffset, alpha, mask.data() + otoffset, cache.gradient.data() + no * nh, no);
+                return lf;
+            }
+
+            /// <summary>
+            /// loss on the dataset, the activations are written to the workspace instead of nn,
+            /// so several threads can evaluate the same network with their own workspaces
+            /// </summary>
+            static double loss(const nn& nn, const std::vector<dataSet>& dataset, workspace& ws) {
+                double delta = 0;
+                for (size_t i = 0; i < dataset.size(); ++i) {
+                    calculateNN(dataset[i].xx, nn, ws);
+                    delta += std::sqrt(cpu::kernels().squaredDistance(ws.ooutput, dataset[i].yy.data(), nn.noutputs));
+                }
+                return delta / 2;
+            }
+
+            /// <summary>
+            /// loss and metrics of the network on the dataset, computed in parallel on the pool.
+            /// The samples are summed up in fixed blocks with compensated summation and the blocks
+            /// are reduced in order, so the result is bit-identical for any number of threads.
+            /// The activations of nn are not touched.
+            /// </summary>
+            static evaluation evaluate(const nn& nn, const std::vector<dataSet>& dataset, threadPool& pool = threadPool::shared()) {
+                const size_t no = nn.noutputs;
+                const size_t nblocks = (dataset.size() + evaluationBlockSize - 1) / evaluationBlockSize;
+                // per block: loss, squared error, absolute error of every output and correct samples
+                typedef struct blockSums {
+                    compensatedSum loss, squared;
+                    std::vector<compensatedSum> absolute;
+                    size_t correct = 0;
+                } blockSums;
+                std::vector<blockSums> blocks(nblocks);
+
+                pool.parallelFor(0, nblocks, [&](size_t first, size_t last, size_t) {
+                    workspace ws = createWorkspace(nn);
+                    for (size_t b = first; b < last; ++b) {
+                        blockSums& sums = blocks[b];
+                        sums.absolute.resize(no);
+                        const size_t end = std::min((b + 1) * evaluationBlockSize, dataset.size());
+                        for (size_t s = b * evaluationBlockSize; s < end; ++s) {
+                            calculateNN(dataset[s].xx, nn, ws);
+                            const double* yy = dataset[s].yy.data();
+                            double squared = 0;
+                            for (size_t j = 0; j < no; ++j) {
+                                const double d = ws.ooutput[j] - yy[j];
+                                squared += d * d;
+                                sums.absolute[j].add(std::fabs(d));
+                            }
+                            sums.loss.add(std::sqrt(squared) / 2);
+                            sums.squared.add(squared);
+                            sums.correct += correct(ws.ooutput, yy, no);
+                        }
                     }
-                    //std::cout << alpha << std::endl;
-                    nn.parameters -= (alpha * deriv);
+                });
+
+                compensatedSum loss, squared;
+                std::vector<compensatedSum> absolute(no);
+                size_t ncorrect = 0;
+                for (const auto& sums : blocks) {
+                    loss.add(sums.loss.value());
+                    squared.add(sums.squared.value());
+                    for (size_t j = 0; j < no; ++j)
+                        absolute[j].add(sums.absolute[j].value());
+                    ncorrect += sums.correct;
+                }
+
+                evaluation e;
+                e.nsamples = dataset.size();
+                e.outputError.assign(no, 0.0);
+                if (dataset.empty())
+                    return e;
+                e.loss = loss.value();
+                e.mse = squared.value() / (dataset.size() * no);
+                e.accuracy = (double)ncorrect / dataset.size();
+                for (size_t j = 0; j < no; ++j)
+                    e.outputError[j] = absolute[j].value() / dataset.size();
+                return e;
+            }
+
+            /// <summary>
+            /// loss on the dataset and its derivative with respect to all parameters (backpropagation),
+            /// the derivative is written to ws.gradient. Does not allocate.
+            /// </summary>
+            static double gradient(const nn& nn, const std::vector<dataSet>& dataset, workspace& ws) {
+                std::fill(ws.gradient, ws.gradient + nn.ntotparameters, 0.0);
+                double lf = 0;
+                for (size_t i = 0; i < dataset.size(); ++i)
+                    lf += backpropagate(dataset[i].xx, dataset[i].yy, nn, ws);
+                return lf;
+            }
+
+            /// <summary>
+            /// adds the derivative of the loss of one sample to ws.gradient (without resetting it)
+            /// and returns the loss of the sample. Does not allocate.
+            /// </summary>
+            static double accumulate(const nn& nn, const dataSet& sample, workspace& ws) {
+                return backpropagate(sample.xx, sample.yy, nn, ws);
+            }
+
+            /// <summary>
+            /// calculate the outputs for a given input into the buffers of the workspace
+            /// (ws.ioutput, ws.houtput, ws.ooutput). Does not allocate.
+            /// </summary>
+            static void calculateNN(const math::vector<double>& xx, const nn& nn, workspace& ws) {
+                const double* p = nn.parameters.data();
+                const double* itheta = p + ithetaOffset(nn);
+                const double* htheta = p + hthetaOffset(nn);
+                const double* otheta = p + othetaOffset(nn);
+                for (size_t i = 0; i < nn.ninputs; ++i)
+                    ws.ioutput[i] = p[i] * xx[i] - itheta[i];
+                activateInner(nn.cconfig, ws.ioutput, nn.ninputs);
+
+                const kernelTable& k = cpu::kernels();
+                k.gemv(p + hweightsOffset(nn), ws.ioutput, ws.houtput, nn.nneurons, nn.ninputs);
+                for (size_t i = 0; i < nn.nneurons; ++i)
+                    ws.houtput[i] -= htheta[i];
+                activateInner(nn.cconfig, ws.houtput, nn.nneurons);
+
+                k.gemv(p + oweightsOffset(nn), ws.houtput, ws.ooutput, nn.noutputs, nn.nneurons);
+                for (size_t i = 0; i < nn.noutputs; ++i)
+                    ws.ooutput[i] += outerThetaSign * otheta[i];
+                activateOuter(nn.cconfig, ws.ooutput, nn.noutputs);
+            }
+
+            /// <summary>
+            /// activations of the zero input for the current parameters, must be refreshed
+            /// whenever itheta, hweights or htheta change
+            /// </summary>
+            static sparseCache prepareSparse(const nn& nn) {
+                sparseCache cache(nn.ninputs, nn.nneurons);
+                prepareSparse(nn, cache);
+                return cache;
+            }
+
+            static void prepareSparse(const nn& nn, sparseCache& cache) {
+                const double* p = nn.parameters.data();
+                const double* htheta = p + hthetaOffset(nn);
+                for (size_t i = 0; i < nn.ninputs; ++i)
+                    cache.ioutput[i] = -p[ithetaOffset(nn) + i];
+                activateInner(nn.cconfig, cache.ioutput.data(), nn.ninputs);
+                cpu::kernels().gemv(p + hweightsOffset(nn), cache.ioutput.data(), cache.hinput.data(), nn.nneurons, nn.ninputs);
+                for (size_t j = 0; j < nn.nneurons; ++j)
+                    cache.hinput[j] -= htheta[j];
+            }
+
+            /// <summary>
+            /// calculate the outputs for a sparse input into ws.houtput and ws.ooutput. Only the
+            /// nonzero input columns are touched; ws.ioutput holds the activations of the
+            /// nonzero inputs in the order of xx.index. Does not allocate.
+            /// </summary>
+            static void calculateNN(const sparseVector& xx, const nn& nn, workspace& ws, const sparseCache& cache) {
+                forwardSparse(xx.index.data(), xx.value.data(), xx.nonzeros(), nn, ws, cache);
+            }
+
+            /// <summary>
+            /// calculate the outputs for a batch of sparse inputs, one sample per row of xx
+            /// </summary>
+            static void calculateNN(const csrMatrix& xx, const nn& nn, std::vector<math::vector<double>>& yy) {
+                workspace ws = createWorkspace(nn);
+                const sparseCache cache = prepareSparse(nn);
+                yy.resize(xx.rows, math::vector<double>(nn.noutputs));
+                for (size_t r = 0; r < xx.rows; ++r) {
+                    const uint32_t begin = xx.rowptr[r];
+                    forwardSparse(xx.colidx.data() + begin, xx.values.data() + begin, xx.rowptr[r + 1] - begin, nn, ws, cache);
+                    std::copy(ws.ooutput, ws.ooutput + nn.noutputs, yy[r].data());
+                }
+            }
+
+            /// <summary>
+            /// loss on a sparse dataset and its derivative with respect to all parameters, written
+            /// to ws.gradient. Per sample only the nonzero input columns are touched, the part of
+            /// the zero inputs is added once for all samples. Refreshes the cache. Does not allocate.
+            /// </summary>
+            static double gradient(const nn& nn, const std::vector<sparseDataSet>& dataset, workspace& ws, sparseCache& cache) {
+                const size_t ni = nn.ninputs, nh = nn.nneurons, no = nn.noutputs;
+                prepareSparse(nn, cache);
+                std::fill(ws.gradient, ws.gradient + nn.ntotparameters, 0.0);
+                std::fill(cache.hsum.begin(), cache.hsum.end(), 0.0);
+
+                const kernelTable& k = cpu::kernels();
+                const double* p = nn.parameters.data();
+                const double* hweights = p + hweightsOffset(nn);
+                double* g = ws.gradient;
+                double* ghweights = g + hweightsOffset(nn);
+                double* githeta = g + ithetaOffset(nn);
+                double lf = 0;
+                for (const auto& d : dataset) {
+                    const size_t nnz = d.xx.nonzeros();
+                    const uint32_t* index = d.xx.index.data();
+                    forwardSparse(index, d.xx.value.data(), nnz, nn, ws, cache);
+
+                    // loss of the sample: |ooutput - yy| / 2
+                    const double delta = std::sqrt(k.squaredDistance(ws.ooutput, d.yy.data(), no));
+                    lf += delta / 2;
+                    if (delta == 0)
+                        continue;
+
+                    // output layer
+                    for (size_t j = 0; j < no; ++j)
+                        ws.odelta[j] = (ws.ooutput[j] - d.yy[j]) / (2 * delta) * outerDerivative(ws.ooutput[j]);
+                    k.ger(g + oweightsOffset(nn), ws.odelta, ws.houtput, no, nh);
+                    for (size_t j = 0; j < no; ++j)
+                        g[othetaOffset(nn) + j] += outerThetaSign * ws.odelta[j];
+
+                    // hidden layer
+                    k.gemvT(p + oweightsOffset(nn), ws.odelta, ws.hdelta, no, nh);
+                    for (size_t j = 0; j < nh; ++j) {
+                        ws.hdelta[j] *= innerDerivative(ws.houtput[j]);
+                        g[hthetaOffset(nn) + j] -= ws.hdelta[j];
+                        cache.hsum[j] += ws.hdelta[j];
+                    }
+
+                    // nonzero input columns: the difference to the zero input (ws.idelta holds
+                    // ioutput - cache.ioutput), the zero input part follows after the loop
+                    for (size_t c = 0; c < nnz; ++c) {
+                        const size_t i = index[c];
+                        double t = 0;
+                        for (size_t j = 0; j < nh; ++j) {
+                            t += hweights[j * ni + i] * ws.hdelta[j];
+                            ghweights[j * ni + i] += ws.hdelta[j] * ws.idelta[c];
+                        }
+                        const double derivative = innerDerivative(ws.ioutput[c]);
+                        g[i] += derivative * t * d.xx.value[c];
+                        githeta[i] -= (derivative - innerDerivative(cache.ioutput[i])) * t;
+                    }
+                }
+
+                // zero input part of all samples at once
+                k.ger(ghweights, cache.hsum.data(), cache.ioutput.data(), nh, ni);
+                k.gemvT(hweights, cache.hsum.data(), cache.scratch.data(), nh, ni);
+                for (size_t i = 0; i < ni; ++i)
+                    githeta[i] -= innerDerivative(cache.ioutput[i]) * cache.scratch[i];
+                return lf;
+            }
+
+            /// <summary>
+            /// one gradient descent step on a sparse dataset, only parameters with mask[i] != 0
+            /// are updated. Returns the loss before the step. Does not allocate.
+            /// </summary>
+            static double step(nn& nn, const std::vector<sparseDataSet>& dataset, const double learningrate, const math::vector<double>& mask, workspace& ws, sparseCache& cache) {
+                const double lf = gradient(nn, dataset, ws, cache);
+                update(nn, ws.gradient, lf, learningrate, mask);
+                return lf;
+            }
+
+            /// <summary>
+            /// train the network on a sparse dataset (gradient descent method)
+            /// </summary>
+            static void train(nn& nn, const std::vector<sparseDataSet>& dataset, const double accuracy, const double learningrate) {
+                const math::vector<double> mask(nn.ntotparameters, 1);
+                workspace ws = createWorkspace(nn);
+                sparseCache cache(nn.ninputs, nn.nneurons);
+                size_t counter = 0;
+                double lf = 0;
+                do {
+                    lf = step(nn, dataset, learningrate, mask, ws, cache);
 
                     // Status
                     if (counter++ % 100 == 0)
@@ -242,6 +998,412 @@ namespace math {
                 } while (lf > accuracy);
             }
 
+            /// <summary>
+            /// magnitude pruning: set all hidden and output weights with |w| < threshold to zero.
+            /// Returns the mask of the surviving parameters (1 keep, 0 pruned) for fine-tuning with train.
+            /// </summary>
+            static math::vector<double> prune(nn& nn, const double threshold) {
+                math::vector<double> mask(nn.ntotparameters, 1);
+                auto apply = [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i) {
+                        if (std::abs(nn.parameters[i]) < threshold) {
+                            nn.parameters[i] = 0;
+                            mask[i] = 0;
+                        }
+                    }
+                };
+                apply(hweightsOffset(nn), hweightsOffset(nn) + nn.nneurons * nn.ninputs);
+                apply(oweightsOffset(nn), oweightsOffset(nn) + nn.noutputs * nn.nneurons);
+                return mask;
+            }
+
+            /// <summary>
+            /// magnitude pruning to a target sparsity in [0, 1]: the given fraction of the hidden
+            /// and output weights with the smallest magnitude is set to zero
+            /// </summary>
+            static math::vector<double> pruneToSparsity(nn& nn, const double sparsity) {
+                std::vector<double> magnitudes;
+                magnitudes.reserve(nn.nneurons * nn.ninputs + nn.noutputs * nn.nneurons);
+                for (size_t i = 0; i < nn.nneurons * nn.ninputs; ++i)
+                    magnitudes.push_back(std::abs(nn.parameters[hweightsOffset(nn) + i]));
+                for (size_t i = 0; i < nn.noutputs * nn.nneurons; ++i)
+                    magnitudes.push_back(std::abs(nn.parameters[oweightsOffset(nn) + i]));
+
+                const size_t nprune = std::min(magnitudes.size(), (size_t)std::llround(sparsity * magnitudes.size()));
+                if (nprune == 0)
+                    return math::vector<double>(nn.ntotparameters, 1);
+                std::nth_element(magnitudes.begin(), magnitudes.begin() + (nprune - 1), magnitudes.end());
+                // prune everything up to and including the nprune-th smallest magnitude
+                return prune(nn, std::nextafter(magnitudes[nprune - 1], INFINITY));
+            }
+
+            /// <summary>
+            /// compress the network into its sparse inference form
+            /// </summary>
+            static sparseNN sparsify(const nn& nn) {
+                sparseNN snn;
+                snn.ninputs = nn.ninputs;
+                snn.noutputs = nn.noutputs;
+                snn.nneurons = nn.nneurons;
+                const double* p = nn.parameters.data();
+                snn.iweights.assign(p, p + nn.ninputs);
+                snn.itheta.assign(p + ithetaOffset(nn), p + ithetaOffset(nn) + nn.ninputs);
+                snn.hweights = csrMatrix(p + hweightsOffset(nn), nn.nneurons, nn.ninputs);
+                snn.htheta.assign(p + hthetaOffset(nn), p + hthetaOffset(nn) + nn.nneurons);
+                snn.oweights = csrMatrix(p + oweightsOffset(nn), nn.noutputs, nn.nneurons);
+                snn.otheta.assign(p + othetaOffset(nn), p + othetaOffset(nn) + nn.noutputs);
+                snn.ioutput.resize(nn.ninputs);
+                snn.houtput.resize(nn.nneurons);
+                return snn;
+            }
+
+            /// <summary>
+            /// calculate the outputs of a sparse network for a given input
+            /// </summary>
+            static void calculateNN(const math::vector<double>& xx, const sparseNN& snn, math::vector<double>& yy) {
+                if (yy.size() != snn.noutputs)
+                    yy.resize(snn.noutputs);
+                double (&func)(double) = innerTransfer;
+                for (size_t i = 0; i < snn.ninputs; ++i)
+                    snn.ioutput[i] = func(snn.iweights[i] * xx[i] - snn.itheta[i]);
+
+                snn.hweights.spmv(snn.ioutput.data(), snn.houtput.data());
+                for (size_t i = 0; i < snn.nneurons; ++i)
+                    snn.houtput[i] = func(snn.houtput[i] - snn.htheta[i]);
+
+                snn.oweights.spmv(snn.houtput.data(), yy.data());
+                for (size_t i = 0; i < snn.noutputs; ++i)
+                    yy[i] = outerTransfer(yy[i] + outerThetaSign * snn.otheta[i]);
+            }
+
+            /// <summary>
+            /// calculate the outputs of a sparse network for a batch of inputs (SpMM)
+            /// </summary>
+            static void calculateNN(const std::vector<math::vector<double>>& xx, const sparseNN& snn, std::vector<math::vector<double>>& yy) {
+                const size_t nbatch = xx.size();
+                std::vector<double> X(snn.ninputs * nbatch), H(snn.nneurons * nbatch), O(snn.noutputs * nbatch);
+                double (&func)(double) = innerTransfer;
+                for (size_t b = 0; b < nbatch; ++b)
+                    for (size_t i = 0; i < snn.ninputs; ++i)
+                        X[i * nbatch + b] = func(snn.iweights[i] * xx[b][i] - snn.itheta[i]);
+
+                snn.hweights.spmm(X.data(), nbatch, H.data());
+                for (size_t i = 0; i < snn.nneurons; ++i)
+                    for (size_t b = 0; b < nbatch; ++b)
+                        H[i * nbatch + b] = func(H[i * nbatch + b] - snn.htheta[i]);
+
+                snn.oweights.spmm(H.data(), nbatch, O.data());
+                yy.resize(nbatch);
+                for (size_t b = 0; b < nbatch; ++b) {
+                    yy[b] = math::vector<double>(snn.noutputs);
+                    for (size_t i = 0; i < snn.noutputs; ++i)
+                        yy[b][i] = outerTransfer(O[i * nbatch + b] + outerThetaSign * snn.otheta[i]);
+                }
+            }
+
+            /// <summary>
+            /// replace the hidden and/or output weights by a truncated SVD U * V
+            /// </summary>
+            static lowRankNN factorize(const nn& nn, const lowRank& config) {
+                lowRankNN lnn;
+                lnn.ninputs = nn.ninputs;
+                lnn.noutputs = nn.noutputs;
+                lnn.nneurons = nn.nneurons;
+                const double* p = nn.parameters.data();
+                lnn.iweights.assign(p, p + nn.ninputs);
+                lnn.itheta.assign(p + ithetaOffset(nn), p + ithetaOffset(nn) + nn.ninputs);
+                if (config.hidden)
+                    lnn.hweights = factoredLayer(p + hweightsOffset(nn), nn.nneurons, nn.ninputs, config);
+                else
+                    lnn.hweights = factoredLayer(p + hweightsOffset(nn), nn.nneurons, nn.ninputs);
+                lnn.htheta.assign(p + hthetaOffset(nn), p + hthetaOffset(nn) + nn.nneurons);
+                if (config.output)
+                    lnn.oweights = factoredLayer(p + oweightsOffset(nn), nn.noutputs, nn.nneurons, config);
+                else
+                    lnn.oweights = factoredLayer(p + oweightsOffset(nn), nn.noutputs, nn.nneurons);
+                lnn.otheta.assign(p + othetaOffset(nn), p + othetaOffset(nn) + nn.noutputs);
+                lnn.ioutput.resize(nn.ninputs);
+                lnn.houtput.resize(nn.nneurons);
+                return lnn;
+            }
+
+            /// <summary>
+            /// factorize and report per layer the kept rank, the loss on dataset with only this
+            /// layer factorized compared to the dense network, and the measured speedup
+            /// </summary>
+            static lowRankNN factorize(const nn& nn, const lowRank& config, const std::vector<dataSet>& dataset, std::vector<lowRankReport>& report) {
+                lowRankNN lnn = factorize(nn, config);
+                lowRank dense = config;
+                dense.hidden = dense.output = false;
+                const lowRankNN dnn = factorize(nn, dense);
+                const double denseLoss = lossFunction(dnn, dataset);
+
+                report.clear();
+                for (int l = 0; l < 2; ++l) {
+                    const bool hidden = l == 0;
+                    if ((hidden && !config.hidden) || (!hidden && !config.output))
+                        continue;
+                    // network with only this layer factorized
+                    lowRankNN single = factorize(nn, dense);
+                    (hidden ? single.hweights : single.oweights) = hidden ? lnn.hweights : lnn.oweights;
+
+                    const factoredLayer& layer = hidden ? lnn.hweights : lnn.oweights;
+                    lowRankReport r;
+                    r.layer = hidden ? "hidden" : "output";
+                    r.rows = layer.rows;
+                    r.cols = layer.cols;
+                    r.rank = layer.rank;
+                    r.energy = layer.energy;
+                    r.denseLoss = denseLoss;
+                    r.factoredLoss = lossFunction(single, dataset);
+                    r.denseTime = timeLayer(hidden ? dnn.hweights : dnn.oweights);
+                    r.factoredTime = timeLayer(layer);
+                    r.speedup = r.factoredTime > 0 ? r.denseTime / r.factoredTime : 1;
+                    report.push_back(r);
+                }
+                return lnn;
+            }
+
+            /// <summary>
+            /// calculate the outputs of a low rank network for a given input
+            /// </summary>
+            static void calculateNN(const math::vector<double>& xx, const lowRankNN& lnn, math::vector<double>& yy) {
+                if (yy.size() != lnn.noutputs)
+                    yy.resize(lnn.noutputs);
+                double (&func)(double) = innerTransfer;
+                for (size_t i = 0; i < lnn.ninputs; ++i)
+                    lnn.ioutput[i] = func(lnn.iweights[i] * xx[i] - lnn.itheta[i]);
+
+                lnn.hweights.apply(lnn.ioutput.data(), lnn.houtput.data());
+                for (size_t i = 0; i < lnn.nneurons; ++i)
+                    lnn.houtput[i] = func(lnn.houtput[i] - lnn.htheta[i]);
+
+                lnn.oweights.apply(lnn.houtput.data(), yy.data());
+                for (size_t i = 0; i < lnn.noutputs; ++i)
+                    yy[i] = outerTransfer(yy[i] + outerThetaSign * lnn.otheta[i]);
+            }
+
+            /// <summary>
+            /// reset the parameters of all members, member k with seed cconfig.init.seed + k
+            /// </summary>
+            static void init(ensemble& ens) {
+                threadPool::shared().parallelFor(0, ens.nmembers, [&](size_t first, size_t last, size_t) {
+                    nn tmp(ens.ninputs, ens.noutputs, ens.nneurons, ens.cconfig);
+                    for (size_t k = first; k < last; ++k) {
+                        init(tmp, ens.cconfig.init.seed + k);
+                        std::copy(tmp.parameters.data(), tmp.parameters.data() + ens.nparameters, ens.member(k));
+                    }
+                });
+            }
+
+            /// <summary>
+            /// copy the parameters of a network into member k and back
+            /// </summary>
+            static void setMember(ensemble& ens, size_t k, const nn& nn) {
+                std::copy(nn.parameters.data(), nn.parameters.data() + ens.nparameters, ens.member(k));
+            }
+
+            static void getMember(const ensemble& ens, size_t k, nn& nn) {
+                std::copy(ens.member(k), ens.member(k) + ens.nparameters, nn.parameters.data());
+            }
+
+            /// <summary>
+            /// train all members in lockstep until every member reached the accuracy. Member k is
+            /// trained on datasets[k], or on datasets[0] if only one dataset is given. Members that
+            /// reached the accuracy are not updated any more.
+            /// </summary>
+            static void train(ensemble& ens, const std::vector<std::vector<dataSet>>& datasets, const double accuracy, const double learningrate) {
+                pack(ens, datasets);
+                std::fill(ens.losses.begin(), ens.losses.end(), INFINITY);
+                size_t counter = 0;
+                double lf = 0;
+                do {
+                    lf = stepPacked(ens, learningrate, accuracy);
+
+                    // Status
+                    if (counter++ % 100 == 0)
+                        std::cout << "max lf  = " << lf << std::endl;
+                } while (lf > accuracy);
+            }
+
+            /// <summary>
+            /// one gradient descent step of all members, returns the largest loss before the step
+            /// (the loss of every member is stored in ens.losses)
+            /// </summary>
+            static double step(ensemble& ens, const std::vector<std::vector<dataSet>>& datasets, const double learningrate) {
+                pack(ens, datasets);
+                return stepPacked(ens, learningrate, -INFINITY);
+            }
+
+            /// <summary>
+            /// average output of all members for a given input
+            /// </summary>
+            static void calculateNN(const math::vector<double>& xx, const ensemble& ens, math::vector<double>& yy) {
+                std::vector<math::vector<double>> yys;
+                calculateNN(std::vector<math::vector<double>>(1, xx), ens, yys);
+                yy = yys[0];
+            }
+
+            /// <summary>
+            /// average output of all members for a batch of inputs. Every call works on its own
+            /// buffers, the scratch of the ensemble (training) is not touched, so several threads
+            /// can evaluate the same ensemble.
+            /// </summary>
+            static void calculateNN(const std::vector<math::vector<double>>& xx, const ensemble& ens, std::vector<math::vector<double>>& yy) {
+                const size_t nsamples = xx.size();
+                Eigen::MatrixXd X(ens.ninputs, nsamples);
+                for (size_t s = 0; s < nsamples; ++s)
+                    for (size_t i = 0; i < ens.ninputs; ++i)
+                        X(i, s) = xx[s][i];
+
+                std::vector<Eigen::MatrixXd> outputs(ens.nmembers);
+                threadPool::shared().parallelFor(0, ens.nmembers, [&](size_t first, size_t last, size_t) {
+                    ensemble::buffers b;
+                    b.xx = X;
+                    for (size_t k = first; k < last; ++k) {
+                        forward(ens, k, b);
+                        outputs[k] = b.ooutput;
+                    }
+                });
+
+                Eigen::MatrixXd average = Eigen::MatrixXd::Zero(ens.noutputs, nsamples);
+                for (size_t k = 0; k < ens.nmembers; ++k)
+                    average += outputs[k];
+                average /= (double)ens.nmembers;
+
+                yy.resize(nsamples);
+                for (size_t s = 0; s < nsamples; ++s) {
+                    yy[s] = math::vector<double>(ens.noutputs);
+                    for (size_t i = 0; i < ens.noutputs; ++i)
+                        yy[s][i] = average(i, s);
+                }
+            }
+
+            /// <summary>
+            /// loss of every member on its dataset and its derivative with respect to the member's
+            /// parameters, gradient is resized to nmembers * nparameters
+            /// </summary>
+            static void gradient(const ensemble& ens, const std::vector<std::vector<dataSet>>& datasets, std::vector<double>& gradient) {
+                pack(ens, datasets);
+                gradient.assign(ens.parameters.size(), 0);
+                for (size_t k = 0; k < ens.nmembers; ++k)
+                    backpropagate(ens, k, gradient.data() + k * ens.nparameters);
+            }
+
+            /// <summary>
+            /// compile the network into its optimized inference form. The outputs of the
+            /// compiled network equal those of calculateNN up to rounding.
+            /// </summary>
+            static compiledNN compile(const nn& nn) {
+                compiledNN cnn;
+                cnn.ninputs = nn.ninputs;
+                cnn.noutputs = nn.noutputs;
+                cnn.inner = nn.cconfig.approx.inner;
+                cnn.outer = nn.cconfig.approx.outer;
+                const double* p = nn.parameters.data();
+                Eigen::Map<const rowMatrix> hweights = hweightsMap(nn), oweights = oweightsMap(nn);
+
+                // inputs with zero weight are constant, fold them into htheta
+                std::vector<double> htheta(p + hthetaOffset(nn), p + hthetaOffset(nn) + nn.nneurons);
+                for (size_t i = 0; i < nn.ninputs; ++i) {
+                    if (p[i] != 0) {
+                        cnn.inputs.push_back((uint32_t)i);
+                        cnn.iweights.push_back(p[i]);
+                        cnn.itheta.push_back(p[ithetaOffset(nn) + i]);
+                        continue;
+                    }
+                    double c = -p[ithetaOffset(nn) + i];
+                    activateInner(cnn.inner, &c, 1);
+                    for (size_t j = 0; j < nn.nneurons; ++j)
+                        htheta[j] -= hweights(j, i) * c;
+                }
+                cnn.nlinputs = cnn.inputs.size();
+
+                // neurons without incoming weights are constant, fold them into otheta;
+                // neurons without outgoing weights do not contribute at all
+                std::vector<double> otheta(p + othetaOffset(nn), p + othetaOffset(nn) + nn.noutputs);
+                std::vector<size_t> neurons;
+                for (size_t j = 0; j < nn.nneurons; ++j) {
+                    bool incoming = false, outgoing = false;
+                    for (size_t i : cnn.inputs)
+                        incoming |= hweights(j, i) != 0;
+                    for (size_t k = 0; k < nn.noutputs; ++k)
+                        outgoing |= oweights(k, j) != 0;
+                    if (!outgoing)
+                        continue;
+                    if (incoming) {
+                        neurons.push_back(j);
+                        continue;
+                    }
+                    double c = -htheta[j];
+                    activateInner(cnn.inner, &c, 1);
+                    for (size_t k = 0; k < nn.noutputs; ++k)
+                        otheta[k] += outerThetaSign * oweights(k, j) * c;
+                }
+                cnn.nlneurons = neurons.size();
+
+                for (size_t j : neurons) {
+                    for (size_t i : cnn.inputs)
+                        cnn.hweights.push_back(hweights(j, i));
+                    cnn.htheta.push_back(htheta[j]);
+                }
+                for (size_t k = 0; k < nn.noutputs; ++k)
+                    for (size_t j : neurons)
+                        cnn.oweights.push_back(oweights(k, j));
+                cnn.otheta = otheta;
+                cnn.buffer.resize(cnn.nlinputs + cnn.nlneurons);
+                return cnn;
+            }
+
+            /// <summary>
+            /// calculate the outputs of a compiled network for a given input
+            /// </summary>
+            static void calculateNN(const math::vector<double>& xx, const compiledNN& cnn, math::vector<double>& yy) {
+                if (yy.size() != cnn.noutputs)
+                    yy.resize(cnn.noutputs);
+                double* io = cnn.buffer.data();
+                double* ho = io + cnn.nlinputs;
+
+                // fused input stage: scaling, threshold and transfer function in one pass
+                for (size_t i = 0; i < cnn.nlinputs; ++i)
+                    io[i] = cnn.iweights[i] * xx[cnn.inputs[i]] - cnn.itheta[i];
+                activateInner(cnn.inner, io, cnn.nlinputs);
+
+                Eigen::Map<Eigen::VectorXd> h(ho, cnn.nlneurons);
+                h.noalias() = Eigen::Map<const rowMatrix>(cnn.hweights.data(), cnn.nlneurons, cnn.nlinputs) * Eigen::Map<const Eigen::VectorXd>(io, cnn.nlinputs);
+                h -= Eigen::Map<const Eigen::VectorXd>(cnn.htheta.data(), cnn.nlneurons);
+                activateInner(cnn.inner, ho, cnn.nlneurons);
+
+                Eigen::Map<Eigen::VectorXd> o(yy.data(), cnn.noutputs);
+                o.noalias() = Eigen::Map<const rowMatrix>(cnn.oweights.data(), cnn.noutputs, cnn.nlneurons) * h;
+                o += outerThetaSign * Eigen::Map<const Eigen::VectorXd>(cnn.otheta.data(), cnn.noutputs);
+                activateOuter(cnn.outer, yy.data(), cnn.noutputs);
+            }
+
+            /// <summary>
+            /// write the network as a self-contained C++ header without runtime sizing
+            /// (see codegen.h)
+            /// </summary>
+            static void exportHeader(const nn& nn, std::ostream& os, const codegenOptions& options = codegenOptions()) {
+                #ifdef SIGMOID
+                    const codegen::transfer inner = codegen::sigmoid, outer = codegen::sigmoid;
+                #endif
+
+                #ifdef RELU
+                    const codegen::transfer inner = codegen::relu, outer = codegen::relu;
+                #endif
+
+                #ifdef TANH
+                    const codegen::transfer inner = codegen::tanh, outer = codegen::tanh;
+                #endif
+
+                #ifdef COMBINED
+                    const codegen::transfer inner = codegen::sigmoid, outer = codegen::relu;
+                #endif
+
+                codegen::writeHeader(os, options, nn.layout, nn.parameters.data(),
+                    inner, outer, outerThetaSign, nn.cconfig.approx.inner.get(), nn.cconfig.approx.outer.get());
+            }
 
         private:
             /// <summary>
@@ -267,6 +1429,114 @@ namespace math {
                 return std::tanh(x);
             }
 
+            /// <summary>
+            /// y[i] = transfer(y[i]) for the input/hidden and the output layer, with the
+            /// tables of config.approx if they are used
+            /// </summary>
+            static void activateInner(const config& config, double* y, size_t n) {
+                activateInner(config.approx.inner, y, n);
+            }
+
+            static void activateOuter(const config& config, double* y, size_t n) {
+                activateOuter(config.approx.outer, y, n);
+            }
+
+            static void activateInner(const std::shared_ptr<const transferTable>& table, double* y, size_t n) {
+                if (table) {
+                    cpu::kernels().interpolate(*table, y, n);
+                    return;
+                }
+                for (size_t i = 0; i < n; ++i)
+                    y[i] = innerTransfer(y[i]);
+            }
+
+            static void activateOuter(const std::shared_ptr<const transferTable>& table, double* y, size_t n) {
+                if (table) {
+                    cpu::kernels().interpolate(*table, y, n);
+                    return;
+                }
+                for (size_t i = 0; i < n; ++i)
+                    y[i] = outerTransfer(y[i]);
+            }
+
+            /// <summary>
+            /// transfer functions of the input/hidden and the output layer as selected above
+            /// (derivatives expressed by the output y of the transfer function)
+            /// and the sign with which otheta enters the output layer
+            /// </summary>
+            #ifdef SIGMOID
+                static double innerTransfer(double x) { return unarySigmoid(x); }
+                static double outerTransfer(double x) { return unarySigmoid(x); }
+                static double innerDerivative(double y) { return y * (1 - y); }
+                static double outerDerivative(double y) { return y * (1 - y); }
+                static constexpr double outerThetaSign = -1;
+            #endif
+
+            #ifdef RELU
+                static double innerTransfer(double x) { return unaryRelu(x); }
+                static double outerTransfer(double x) { return unaryRelu(x); }
+                static double innerDerivative(double y) { return y > 0 ? 1 : 0; }
+                static double outerDerivative(double y) { return y > 0 ? 1 : 0; }
+                static constexpr double outerThetaSign = -1;
+            #endif
+
+            #ifdef TANH
+                static double innerTransfer(double x) { return unaryTanh(x); }
+                static double outerTransfer(double x) { return unaryTanh(x); }
+                static double innerDerivative(double y) { return 1 - y * y; }
+                static double outerDerivative(double y) { return 1 - y * y; }
+                static constexpr double outerThetaSign = -1;
+            #endif
+
+            #ifdef COMBINED
+                static double innerTransfer(double x) { return unarySigmoid(x); }
+                static double outerTransfer(double x) { return unaryRelu(x); }
+                static double innerDerivative(double y) { return y * (1 - y); }
+                static double outerDerivative(double y) { return y > 0 ? 1 : 0; }
+                static constexpr double outerThetaSign = 1;
+            #endif
+
+            /// <summary>
+            /// forward pass of nnz nonzero inputs starting from the zero input in the cache.
+            /// ws.ioutput[c] and ws.idelta[c] hold the activation of the c-th nonzero input and
+            /// its difference to the activation of a zero input.
+            /// </summary>
+            static void forwardSparse(const uint32_t* index, const double* value, size_t nnz, const nn& nn, workspace& ws, const sparseCache& cache) {
+                const size_t ni = nn.ninputs;
+                const double* p = nn.parameters.data();
+                const double* itheta = p + ithetaOffset(nn);
+                const double* hweights = p + hweightsOffset(nn);
+                const double* otheta = p + othetaOffset(nn);
+                for (size_t c = 0; c < nnz; ++c)
+                    ws.ioutput[c] = p[index[c]] * value[c] - itheta[index[c]];
+                activateInner(nn.cconfig, ws.ioutput, nnz);
+                for (size_t c = 0; c < nnz; ++c)
+                    ws.idelta[c] = ws.ioutput[c] - cache.ioutput[index[c]];
+
+                for (size_t j = 0; j < nn.nneurons; ++j) {
+                    double h = cache.hinput[j];
+                    for (size_t c = 0; c < nnz; ++c)
+                        h += hweights[j * ni + index[c]] * ws.idelta[c];
+                    ws.houtput[j] = h;
+                }
+                activateInner(nn.cconfig, ws.houtput, nn.nneurons);
+
+                cpu::kernels().gemv(p + oweightsOffset(nn), ws.houtput, ws.ooutput, nn.noutputs, nn.nneurons);
+                for (size_t i = 0; i < nn.noutputs; ++i)
+                    ws.ooutput[i] += outerThetaSign * otheta[i];
+                activateOuter(nn.cconfig, ws.ooutput, nn.noutputs);
+            }
+
+            /// <summary>
+            /// true if the largest output is at the position of the largest target, for a single
+            /// output if both are on the same side of 0.5
+            /// </summary>
+            static bool correct(const double* ooutput, const double* yy, size_t n) {
+                if (n == 1)
+                    return (ooutput[0] >= 0.5) == (yy[0] >= 0.5);
+                return std::max_element(ooutput, ooutput + n) - ooutput == std::max_element(yy, yy + n) - yy;
+            }
+
             /// <summary>
             /// loss function
             /// </summary>
@@ -283,13 +1553,280 @@ namespace math {
                 return delta / 2;
             }
 
+            /// <summary>
+            /// forward and backward pass for one sample, adds weight times the derivative of its
+            /// loss to ws.gradient and returns the (unweighted) loss
+            /// </summary>
+            static double backpropagate(const math::vector<double>& xx, const math::vector<double>& yy, const nn& nn, workspace& ws, const double weight = 1) {
+                calculateNN(xx, nn, ws);
+
+                // loss of the sample: |ooutput - yy| / 2
+                const kernelTable& k = cpu::kernels();
+                const double delta = std::sqrt(k.squaredDistance(ws.ooutput, yy.data(), nn.noutputs));
+                if (delta == 0)
+                    return 0;
+
+                const double* p = nn.parameters.data();
+                double* g = ws.gradient;
+
+                // output layer
+                for (size_t j = 0; j < nn.noutputs; ++j)
+                    ws.odelta[j] = weight * (ws.ooutput[j] - yy[j]) / (2 * delta) * outerDerivative(ws.ooutput[j]);
+                k.ger(g + oweightsOffset(nn), ws.odelta, ws.houtput, nn.noutputs, nn.nneurons);
+                for (size_t j = 0; j < nn.noutputs; ++j)
+                    g[othetaOffset(nn) + j] += outerThetaSign * ws.odelta[j];
+
+                // hidden layer
+                k.gemvT(p + oweightsOffset(nn), ws.odelta, ws.hdelta, nn.noutputs, nn.nneurons);
+                for (size_t j = 0; j < nn.nneurons; ++j)
+                    ws.hdelta[j] *= innerDerivative(ws.houtput[j]);
+                k.ger(g + hweightsOffset(nn), ws.hdelta, ws.ioutput, nn.nneurons, nn.ninputs);
+                for (size_t j = 0; j < nn.nneurons; ++j)
+                    g[hthetaOffset(nn) + j] -= ws.hdelta[j];
+
+                // input layer
+                k.gemvT(p + hweightsOffset(nn), ws.hdelta, ws.idelta, nn.nneurons, nn.ninputs);
+                for (size_t j = 0; j < nn.ninputs; ++j) {
+                    ws.idelta[j] *= innerDerivative(ws.ioutput[j]);
+                    g[j] += ws.idelta[j] * xx[j];
+                    g[ithetaOffset(nn) + j] -= ws.idelta[j];
+                }
+                return delta / 2;
+            }
+
+            /// <summary>
+            /// copy the datasets of all members into their scratch buffers (one column per sample)
+            /// </summary>
+            static void pack(const ensemble& ens, const std::vector<std::vector<dataSet>>& datasets) {
+                for (size_t k = 0; k < ens.nmembers; ++k) {
+                    const std::vector<dataSet>& dataset = datasets.size() == 1 ? datasets[0] : datasets.at(k);
+                    ensemble::buffers& b = ens.scratch[k];
+                    b.xx.resize(ens.ninputs, dataset.size());
+                    b.yy.resize(ens.noutputs, dataset.size());
+                    for (size_t s = 0; s < dataset.size(); ++s) {
+                        for (size_t i = 0; i < ens.ninputs; ++i)
+                            b.xx(i, s) = dataset[s].xx[i];
+                        for (size_t i = 0; i < ens.noutputs; ++i)
+                            b.yy(i, s) = dataset[s].yy[i];
+                    }
+                }
+            }
+
+            /// <summary>
+            /// gradient descent step of all members on the packed datasets, members with a loss
+            /// below accuracy are not updated. Returns the largest loss.
+            /// </summary>
+            static double stepPacked(ensemble& ens, const double learningrate, const double accuracy) {
+                threadPool::shared().parallelFor(0, ens.nmembers, [&](size_t first, size_t last, size_t) {
+                    std::vector<double> g(ens.nparameters);
+                    for (size_t k = first; k < last; ++k) {
+                        // parameters and data of a converged member did not change, neither did its loss
+                        if (ens.losses[k] <= accuracy)
+                            continue;
+                        std::fill(g.begin(), g.end(), 0.0);
+                        const double lf = backpropagate(ens, k, g.data());
+                        ens.losses[k] = lf;
+                        if (lf <= accuracy)
+                            continue;
+                        const double alpha = adaptLearningRate(ens.adaptives[k], lf, learningrate);
+                        double* p = ens.member(k);
+                        for (size_t i = 0; i < ens.nparameters; ++i)
+                            p[i] -= alpha * g[i];
+                    }
+                });
+                return *std::max_element(ens.losses.begin(), ens.losses.end());
+            }
+
+            /// <summary>
+            /// forward pass of member k for all columns of b.xx (the scratch of member k during training)
+            /// </summary>
+            static void forward(const ensemble& ens, size_t k, ensemble::buffers& b) {
+                const double* p = ens.member(k);
+                const size_t nsamples = b.xx.cols();
+                const parameterLayout& l = ens.layout;
+                Eigen::Map<const Eigen::VectorXd> iweights(p + l.iweights, ens.ninputs), itheta(p + l.itheta, ens.ninputs);
+                Eigen::Map<const rowMatrix> hweights(p + l.hweights, ens.nneurons, ens.ninputs);
+                Eigen::Map<const Eigen::VectorXd> htheta(p + l.htheta, ens.nneurons);
+                Eigen::Map<const rowMatrix> oweights(p + l.oweights, ens.noutputs, ens.nneurons);
+                Eigen::Map<const Eigen::VectorXd> otheta(p + l.otheta, ens.noutputs);
+
+                b.ioutput = (b.xx.array().colwise() * iweights.array()).colwise() - itheta.array();
+                activateInner(ens.cconfig, b.ioutput.data(), b.ioutput.size());
+
+                b.houtput.resize(ens.nneurons, nsamples);
+                b.houtput.noalias() = hweights * b.ioutput;
+                b.houtput.colwise() -= htheta;
+                activateInner(ens.cconfig, b.houtput.data(), b.houtput.size());
+
+                b.ooutput.resize(ens.noutputs, nsamples);
+                b.ooutput.noalias() = oweights * b.houtput;
+                b.ooutput.colwise() += outerThetaSign * otheta;
+                activateOuter(ens.cconfig, b.ooutput.data(), b.ooutput.size());
+            }
+
+            /// <summary>
+            /// forward and backward pass of member k for all samples of its packed dataset, adds
+            /// the derivative of the loss to g and returns the loss
+            /// </summary>
+            static double backpropagate(const ensemble& ens, size_t k, double* g) {
+                ensemble::buffers& b = ens.scratch[k];
+                forward(ens, k, b);
+                const double* p = ens.member(k);
+                const size_t nsamples = b.xx.cols();
+
+                // output layer: delta = (ooutput - yy) / (2 |ooutput - yy|) * g'
+                double lf = 0;
+                b.odelta = b.ooutput - b.yy;
+                for (size_t s = 0; s < nsamples; ++s) {
+                    const double delta = b.odelta.col(s).norm();
+                    lf += delta / 2;
+                    for (size_t j = 0; j < ens.noutputs; ++j)
+                        b.odelta(j, s) = delta == 0 ? 0 : b.odelta(j, s) / (2 * delta) * outerDerivative(b.ooutput(j, s));
+                }
+                const parameterLayout& l = ens.layout;
+                Eigen::Map<const rowMatrix> oweights(p + l.oweights, ens.noutputs, ens.nneurons);
+                Eigen::Map<rowMatrix>(g + l.oweights, ens.noutputs, ens.nneurons).noalias() += b.odelta * b.houtput.transpose();
+                Eigen::Map<Eigen::VectorXd>(g + l.otheta, ens.noutputs) += outerThetaSign * b.odelta.rowwise().sum();
+
+                // hidden layer
+                Eigen::Map<const rowMatrix> hweights(p + l.hweights, ens.nneurons, ens.ninputs);
+                b.hdelta.resize(ens.nneurons, nsamples);
+                b.hdelta.noalias() = oweights.transpose() * b.odelta;
+                for (Eigen::Index i = 0; i < b.hdelta.size(); ++i)
+                    b.hdelta.data()[i] *= innerDerivative(b.houtput.data()[i]);
+                Eigen::Map<rowMatrix>(g + l.hweights, ens.nneurons, ens.ninputs).noalias() += b.hdelta * b.ioutput.transpose();
+                Eigen::Map<Eigen::VectorXd>(g + l.htheta, ens.nneurons) -= b.hdelta.rowwise().sum();
+
+                // input layer
+                b.idelta.resize(ens.ninputs, nsamples);
+                b.idelta.noalias() = hweights.transpose() * b.hdelta;
+                for (Eigen::Index i = 0; i < b.idelta.size(); ++i)
+                    b.idelta.data()[i] *= innerDerivative(b.ioutput.data()[i]);
+                Eigen::Map<Eigen::VectorXd>(g + l.iweights, ens.ninputs) += b.idelta.cwiseProduct(b.xx).rowwise().sum();
+                Eigen::Map<Eigen::VectorXd>(g + l.itheta, ens.ninputs) -= b.idelta.rowwise().sum();
+                return lf;
+            }
+
+            /// <summary>
+            /// learning rate of the next step, adapted to the change of the loss function if
+            /// adapt.apply is set
+            /// </summary>
+            static double adaptLearningRate(const adaptive& adapt, const double lf, const double learningrate) {
+                double alpha = learningrate;
+
+                if (adapt.apply) {
+                    auto& save = adapt.save;
+                    auto& lowerThreshold = adapt.lowerThreshold;
+                    auto& upperThreshold = adapt.upperThreshold;
+                    auto& nAdapt = adapt.nAdapt;
+                    auto& maxnAdapt = adapt.maxnAdapt;
+                    auto& increase = adapt.increase;
+                    // if there is only a small change in the lossfunction during
+                    // two subsequent iterations, increase the learning rate, else decrease it
+                    if(std::abs(lf - save) < lowerThreshold) nAdapt++;
+                    if(std::fabs(lf - save) > upperThreshold) nAdapt--;
+                    if (nAdapt < -maxnAdapt) nAdapt = -maxnAdapt;
+                    if (nAdapt > maxnAdapt) nAdapt = maxnAdapt;
+                    double fac = std::pow(1 + increase, nAdapt);
+                    alpha = alpha * fac;
+                    save = lf;
+                }
+                return alpha;
+            }
+
+            /// <summary>
+            /// loss function of a low rank network
+            /// </summary>
+            static double lossFunction(const lowRankNN& lnn, const std::vector<dataSet>& dataset) {
+                double delta = 0;
+                math::vector<double> yy(lnn.noutputs);
+                for(size_t i = 0; i < dataset.size(); ++i) {
+                    calculateNN(dataset[i].xx, lnn, yy);
+                    double delta2 = 0;
+                    for(size_t j = 0; j < dataset[i].yy.size(); ++j) {
+                        delta2 += std::pow(yy[j] - dataset[i].yy[j], 2);
+                    }
+                    delta += std::sqrt(delta2);
+                }
+                return delta / 2;
+            }
+
+            /// <summary>
+            /// average time (ms) of one matrix-vector product with the layer
+            /// </summary>
+            static double timeLayer(const factoredLayer& layer) {
+                std::vector<double> x(layer.cols, 1), y(layer.rows);
+                const size_t nexec = std::max<size_t>(1, 10000000 / std::max<size_t>(1, layer.rows * layer.cols));
+                auto t_start = std::chrono::high_resolution_clock::now();
+                for (size_t e = 0; e < nexec; ++e) {
+                    layer.apply(x.data(), y.data());
+                    x[e % layer.cols] = y[e % layer.rows];
+                }
+                auto t_end = std::chrono::high_resolution_clock::now();
+                return std::chrono::duration<double, std::milli>(t_end - t_start).count() / nexec;
+            }
+
             /// <summary>
             /// random number generator
             /// </summary>
-            static double rnd(double a, double b){
-                double x = (double)rand() / (double)(RAND_MAX) * (b - a) + a;
-                return x;
+            static double rnd(random::xoshiro256& gen, double a, double b){
+                return gen.uniform(a, b);
             }
-            
+
+            /// <summary>
+            /// half width of the uniform initialization interval of a layer
+            /// </summary>
+            static double initLimit(initialization::scheme method, size_t fanin, size_t fanout) {
+                if (method == initialization::he)
+                    return std::sqrt(6.0 / fanin);
+                return std::sqrt(6.0 / (fanin + fanout));
+            }
+
+            /// <summary>
+            /// offsets of the parameter blocks in nn.parameters
+            /// </summary>
+            static size_t ithetaOffset(const nn& nn) {
+                return nn.layout.itheta;
+            }
+
+            static size_t hweightsOffset(const nn& nn) {
+                return nn.layout.hweights;
+            }
+
+            static size_t oweightsOffset(const nn& nn) {
+                return nn.layout.oweights;
+            }
+
+            static size_t hthetaOffset(const nn& nn) {
+                return nn.layout.htheta;
+            }
+
+            static size_t othetaOffset(const nn& nn) {
+                return nn.layout.otheta;
+            }
+
+            /// <summary>
+            /// row-major views of hweights and oweights for the Eigen kernels
+            /// </summary>
+            typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> rowMatrix;
+
+            static Eigen::Map<const rowMatrix> hweightsMap(const nn& nn) {
+                return Eigen::Map<const rowMatrix>(nn.parameters.data() + hweightsOffset(nn), nn.nneurons, nn.ninputs);
+            }
+
+            static Eigen::Map<const rowMatrix> oweightsMap(const nn& nn) {
+                return Eigen::Map<const rowMatrix>(nn.parameters.data() + oweightsOffset(nn), nn.noutputs, nn.nneurons);
+            }
+
+            /// <summary>
+            /// number of parameters that share one generator stream during init
+            /// </summary>
+            static constexpr size_t initBlockSize = 1 << 14;
+
+            /// <summary>
+            /// number of samples that are summed up serially during evaluate
+            /// </summary>
+            static constexpr size_t evaluationBlockSize = 1 << 10;
+
     };
 }
\ No newline at end of file
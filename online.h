@@ -0,0 +1,117 @@
+/*
+ *  online.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "nn.h"
+
+namespace math {
+    // config of the online learning
+    typedef struct onlineOptions {
+        // learning rate of update t: learningrate / (1 + decay * t), further adapted by
+        // nn.cconfig.adaptive if it is applied
+        double learningrate = 1;
+        double decay = 1e-3;
+        // number of recent samples kept for replay
+        size_t window = 256;
+        // samples of the window replayed with every update
+        size_t replay = 2;
+        uint64_t seed = 5489;
+    } onlineOptions;
+
+    /// <summary>
+    /// trains a network on samples as they arrive. Every call of learn is one gradient descent
+    /// update on the new samples and a few samples replayed from a sliding window of recent data,
+    /// so its cost is bounded by (samples + replay) backpropagations and does not grow with the
+    /// number of samples seen. learn does not allocate.
+    /// </summary>
+    class onlineLearner {
+        public:
+            onlineLearner(nn& _model, const onlineOptions& _options = onlineOptions())
+                : model(_model), options(_options), ws(supervisor::createWorkspace(_model)),
+                  mask(_model.ntotparameters, 1), window(std::max<size_t>(1, _options.window), dataSet(_model.ninputs, _model.noutputs)),
+                  head(0), count(0), nupdates(0), gen(_options.seed) {}
+
+            onlineLearner(const onlineLearner&) = delete;
+            onlineLearner& operator=(const onlineLearner&) = delete;
+
+            /// <summary>
+            /// one update with a single new sample, returns its loss before the update
+            /// </summary>
+            double learn(const dataSet& sample) {
+                std::fill(ws.gradient, ws.gradient + model.ntotparameters, 0.0);
+                const double lf = supervisor::accumulate(model, sample, ws);
+                finish(lf);
+                remember(sample);
+                return lf;
+            }
+
+            /// <summary>
+            /// one update with a small batch of new samples, returns their loss before the update
+            /// </summary>
+            double learn(const std::vector<dataSet>& batch) {
+                std::fill(ws.gradient, ws.gradient + model.ntotparameters, 0.0);
+                double lf = 0;
+                for (const auto& sample : batch)
+                    lf += supervisor::accumulate(model, sample, ws);
+                finish(lf);
+                for (const auto& sample : batch)
+                    remember(sample);
+                return lf;
+            }
+
+            /// <summary>
+            /// learning rate of the next update before adaption
+            /// </summary>
+            double learningRate() const {
+                return options.learningrate / (1 + options.decay * nupdates);
+            }
+
+            /// <summary>
+            /// number of updates so far and number of samples in the window
+            /// </summary>
+            size_t updates() const {
+                return nupdates;
+            }
+
+            size_t size() const {
+                return count;
+            }
+
+        private:
+            /// <summary>
+            /// add the replayed samples to the gradient and update the parameters
+            /// </summary>
+            void finish(double lf) {
+                for (size_t r = 0; r < options.replay && count > 0; ++r)
+                    lf += supervisor::accumulate(model, window[gen() % count], ws);
+                supervisor::update(model, ws.gradient, lf, learningRate(), mask);
+                ++nupdates;
+            }
+
+            /// <summary>
+            /// copy the sample into the window, the oldest sample is overwritten once it is full
+            /// </summary>
+            void remember(const dataSet& sample) {
+                dataSet& slot = window[head];
+                std::copy(sample.xx.data(), sample.xx.data() + model.ninputs, slot.xx.data());
+                std::copy(sample.yy.data(), sample.yy.data() + model.noutputs, slot.yy.data());
+                head = (head + 1) % window.size();
+                count = std::min(count + 1, window.size());
+            }
+
+            nn& model;
+            onlineOptions options;
+            workspace ws;
+            math::vector<double> mask;
+            std::vector<dataSet> window;
+            size_t head, count, nupdates;
+            random::xoshiro256 gen;
+    };
+}
@@ -0,0 +1,100 @@
+/*
+ *  predict.cpp
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <Eigen/Dense>
+
+#include "modelfile.h"
+#include "predict.h"
+
+static void usage() {
+    std::cerr << "usage: predict <model> [input|-] [-o output] [--format csv|binary] [--batch rows] [--threads n]" << std::endl;
+}
+
+int main(int argc, char* args[]) {
+    // the samples of a batch run in parallel, no nested parallelism inside Eigen
+    Eigen::setNbThreads(1);
+
+    const char* modelPath = nullptr;
+    const char* inputPath = "-";
+    const char* outputPath = "-";
+    bool haveInput = false;
+    math::predictOptions options;
+    for (int a = 1; a < argc; ++a) {
+        const bool hasValue = a + 1 < argc;
+        if (std::strcmp(args[a], "-o") == 0 && hasValue) {
+            outputPath = args[++a];
+        } else if (std::strcmp(args[a], "--format") == 0 && hasValue) {
+            const char* form = args[++a];
+            if (std::strcmp(form, "csv") == 0) {
+                options.form = math::predictOptions::csv;
+            } else if (std::strcmp(form, "binary") == 0) {
+                options.form = math::predictOptions::binary;
+            } else {
+                usage();
+                return 1;
+            }
+        } else if (std::strcmp(args[a], "--batch") == 0 && hasValue) {
+            options.batch = std::strtoul(args[++a], nullptr, 10);
+        } else if (std::strcmp(args[a], "--threads") == 0 && hasValue) {
+            options.nthreads = std::strtoul(args[++a], nullptr, 10);
+        } else if (!modelPath) {
+            modelPath = args[a];
+        } else if (!haveInput) {
+            inputPath = args[a];
+            haveInput = true;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (!modelPath) {
+        usage();
+        return 1;
+    }
+
+    std::unique_ptr<math::nn> nn = math::modelFile::load(modelPath);
+    if (!nn) {
+        std::cerr << "cannot load model " << modelPath << std::endl;
+        return 1;
+    }
+
+    const auto mode = options.form == math::predictOptions::binary ? std::ios::binary : std::ios::openmode();
+    std::ifstream ifs;
+    std::ofstream ofs;
+    if (std::strcmp(inputPath, "-") != 0) {
+        ifs.open(inputPath, mode);
+        if (!ifs) {
+            std::cerr << "cannot open " << inputPath << std::endl;
+            return 1;
+        }
+    }
+    if (std::strcmp(outputPath, "-") != 0) {
+        ofs.open(outputPath, mode);
+        if (!ofs) {
+            std::cerr << "cannot open " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::istream& is = ifs.is_open() ? ifs : std::cin;
+    std::ostream& os = ofs.is_open() ? ofs : std::cout;
+    std::ios::sync_with_stdio(false);
+
+    math::predictReport report;
+    const bool ok = math::predictor::run(*nn, is, os, options, report);
+    std::cerr << report.rows << " rows in " << report.seconds << " s, " << report.rowsPerSecond() << " rows/s" << std::endl;
+    if (!ok) {
+        if (report.badRow)
+            std::cerr << "malformed input in row " << report.badRow << std::endl;
+        else
+            std::cerr << "cannot write the output" << std::endl;
+        return 1;
+    }
+    return 0;
+}
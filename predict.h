@@ -0,0 +1,159 @@
+/*
+ *  predict.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nn.h"
+
+namespace math {
+    // config of the batch prediction
+    typedef struct predictOptions {
+        // csv: one sample per line, values separated by commas or whitespace
+        // binary: ninputs (noutputs) doubles per sample in the byte order of the machine
+        enum format { csv, binary };
+        format form = csv;
+        // samples read, predicted and written at once, bounds the memory to
+        // batch * (ninputs + noutputs) doubles
+        size_t batch = 4096;
+        // threads of the inference
+        size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+    } predictOptions;
+
+    /// <summary>
+    /// rows predicted and the time it took, line (csv) or row (binary) of the first
+    /// malformed input if prediction stopped early
+    /// </summary>
+    typedef struct predictReport {
+        size_t rows = 0;
+        size_t badRow = 0;
+        double seconds = 0;
+
+        double rowsPerSecond() const {
+            return seconds > 0 ? rows / seconds : 0;
+        }
+    } predictReport;
+
+    /// <summary>
+    /// streams samples from is through a network and writes the outputs to os in the same
+    /// format and order. Every batch is predicted in parallel, one workspace per chunk.
+    /// </summary>
+    class predictor {
+        public:
+            /// <summary>
+            /// returns false if the input is malformed (see report.badRow) or the output fails
+            /// </summary>
+            static bool run(const nn& nn, std::istream& is, std::ostream& os, const predictOptions& options, predictReport& report) {
+                auto t_start = std::chrono::high_resolution_clock::now();
+                const size_t ni = nn.ninputs, no = nn.noutputs;
+                const size_t batch = std::max<size_t>(1, options.batch);
+                threadPool pool(std::max<size_t>(1, options.nthreads));
+                std::vector<double> xx(batch * ni), yy(batch * no);
+                std::vector<workspace> ws;
+                std::vector<math::vector<double>> inputs(pool.size(), math::vector<double>(ni));
+                ws.reserve(pool.size());
+                for (size_t c = 0; c < pool.size(); ++c)
+                    ws.push_back(supervisor::createWorkspace(nn));
+
+                size_t line = 0;
+                bool ok = true;
+                for (;;) {
+                    size_t n = 0;
+                    ok = options.form == predictOptions::csv ? readCsv(is, xx.data(), ni, batch, n, line) : readBinary(is, xx.data(), ni, batch, n);
+                    if (!ok)
+                        report.badRow = options.form == predictOptions::csv ? line : report.rows + n + 1;
+                    if (n == 0)
+                        break;
+
+                    pool.parallelFor(0, n, pool.size(), [&](size_t first, size_t last, size_t c) {
+                        for (size_t r = first; r < last; ++r) {
+                            std::copy(xx.data() + r * ni, xx.data() + (r + 1) * ni, inputs[c].data());
+                            supervisor::calculateNN(inputs[c], nn, ws[c]);
+                            std::copy(ws[c].ooutput, ws[c].ooutput + no, yy.data() + r * no);
+                        }
+                    });
+
+                    if (options.form == predictOptions::csv)
+                        writeCsv(os, yy.data(), no, n);
+                    else
+                        os.write(reinterpret_cast<const char*>(yy.data()), n * no * sizeof(double));
+                    report.rows += n;
+                    if (!ok || !os)
+                        break;
+                }
+                os.flush();
+
+                auto t_end = std::chrono::high_resolution_clock::now();
+                report.seconds = std::chrono::duration<double>(t_end - t_start).count();
+                return ok && (bool)os;
+            }
+
+        private:
+            /// <summary>
+            /// read up to batch lines into xx, blank lines are skipped. Returns false at the first
+            /// line that does not hold ninputs numbers, n are the rows read before it.
+            /// </summary>
+            static bool readCsv(std::istream& is, double* xx, size_t ni, size_t batch, size_t& n, size_t& line) {
+                std::string text;
+                while (n < batch && std::getline(is, text)) {
+                    ++line;
+                    const char* p = text.c_str();
+                    while (*p == ' ' || *p == '\t' || *p == '\r')
+                        ++p;
+                    if (*p == '\0')
+                        continue;
+                    double* row = xx + n * ni;
+                    for (size_t i = 0; i < ni; ++i) {
+                        while (*p == ',' || *p == ' ' || *p == '\t')
+                            ++p;
+                        char* end;
+                        row[i] = std::strtod(p, &end);
+                        if (end == p)
+                            return false;
+                        p = end;
+                    }
+                    while (*p == ',' || *p == ' ' || *p == '\t' || *p == '\r')
+                        ++p;
+                    if (*p != '\0')
+                        return false;
+                    ++n;
+                }
+                return true;
+            }
+
+            /// <summary>
+            /// read up to batch rows into xx, returns false if the stream ends inside a row
+            /// </summary>
+            static bool readBinary(std::istream& is, double* xx, size_t ni, size_t batch, size_t& n) {
+                const size_t rowBytes = ni * sizeof(double);
+                is.read(reinterpret_cast<char*>(xx), batch * rowBytes);
+                const size_t bytes = (size_t)is.gcount();
+                n = bytes / rowBytes;
+                return bytes % rowBytes == 0;
+            }
+
+            static void writeCsv(std::ostream& os, const double* yy, size_t no, size_t n) {
+                char buffer[32];
+                std::string text;
+                for (size_t r = 0; r < n; ++r) {
+                    for (size_t j = 0; j < no; ++j) {
+                        std::snprintf(buffer, sizeof(buffer), "%.17g", yy[r * no + j]);
+                        text += buffer;
+                        text += j + 1 < no ? ',' : '\n';
+                    }
+                }
+                os << text;
+            }
+    };
+}
@@ -0,0 +1,88 @@
+/*
+ *  random.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+namespace math {
+    namespace random {
+        /// <summary>
+        /// splitmix64 step, used to expand a seed into generator states
+        /// </summary>
+        inline uint64_t splitmix64(uint64_t& state) {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        /// <summary>
+        /// xoshiro256** generator. Every (seed, stream) pair yields an independent,
+        /// reproducible sequence, so each thread or block of work can own its generator
+        /// without sharing state.
+        /// </summary>
+        class xoshiro256 {
+            public:
+                typedef uint64_t result_type;
+
+                xoshiro256(uint64_t seed = 0, uint64_t stream = 0) {
+                    uint64_t sm = seed ^ (0xd1b54a32d192ed03ULL * (stream + 1));
+                    for (int i = 0; i < 4; ++i)
+                        s[i] = splitmix64(sm);
+                }
+
+                static constexpr result_type min() { return 0; }
+                static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+                /// <summary>
+                /// next raw 64 bit value
+                /// </summary>
+                result_type operator()() {
+                    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+                    const uint64_t t = s[1] << 17;
+                    s[2] ^= s[0];
+                    s[3] ^= s[1];
+                    s[1] ^= s[2];
+                    s[0] ^= s[3];
+                    s[2] ^= t;
+                    s[3] = rotl(s[3], 45);
+                    return result;
+                }
+
+                /// <summary>
+                /// uniformly distributed double in [0, 1)
+                /// </summary>
+                double uniform() {
+                    return (double)((*this)() >> 11) * 0x1.0p-53;
+                }
+
+                /// <summary>
+                /// uniformly distributed double in [a, b)
+                /// </summary>
+                double uniform(double a, double b) {
+                    return a + (b - a) * uniform();
+                }
+
+                /// <summary>
+                /// normally distributed double (Box-Muller)
+                /// </summary>
+                double normal(double mean = 0, double stddev = 1) {
+                    double u1 = 1 - uniform(); // (0, 1]
+                    double u2 = uniform();
+                    return mean + stddev * std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+                }
+
+            private:
+                static uint64_t rotl(const uint64_t x, int k) {
+                    return (x << k) | (x >> (64 - k));
+                }
+
+                uint64_t s[4];
+        };
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ *  sampling.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "random.h"
+
+namespace math {
+    /// <summary>
+    /// evaluations spent by supervisor::trainSampled. A backward pass includes its forward pass.
+    /// </summary>
+    typedef struct samplingReport {
+        size_t steps = 0;
+        // forward passes of the full refreshes of the loss estimates
+        size_t forwards = 0;
+        // forward and backward passes of the mini-batches
+        size_t backwards = 0;
+        // loss of the last full refresh
+        double loss = 0;
+    } samplingReport;
+
+    /// <summary>
+    /// draws indices with probability proportional to non-negative priorities (sum tree).
+    /// Setting a priority and drawing an index take O(log n), so a mini-batch costs
+    /// O(batch log n) independent of the size of the dataset.
+    /// </summary>
+    class prioritySampler {
+        public:
+            prioritySampler(size_t _n, uint64_t seed = 0)
+                : n(_n), leaves(1), gen(seed) {
+                while (leaves < n)
+                    leaves *= 2;
+                tree.assign(2 * leaves, 0.0);
+            }
+
+            size_t size() const {
+                return n;
+            }
+
+            /// <summary>
+            /// sum of all priorities
+            /// </summary>
+            double total() const {
+                return tree[1];
+            }
+
+            double priority(size_t i) const {
+                return tree[leaves + i];
+            }
+
+            /// <summary>
+            /// set the priority of index i, 0 excludes it from the draws
+            /// </summary>
+            void set(size_t i, double value) {
+                size_t node = leaves + i;
+                tree[node] = std::max(0.0, value);
+                for (node /= 2; node >= 1; node /= 2)
+                    tree[node] = tree[2 * node] + tree[2 * node + 1];
+            }
+
+            /// <summary>
+            /// index drawn with probability priority(i) / total(). total() must be positive.
+            /// </summary>
+            size_t draw() {
+                double u = gen.uniform() * total();
+                size_t node = 1;
+                while (node < leaves) {
+                    const double left = tree[2 * node];
+                    // rounding can leave u slightly above the sum, never descend into an empty subtree
+                    if (u < left || tree[2 * node + 1] <= 0) {
+                        node = 2 * node;
+                    } else {
+                        u -= left;
+                        node = 2 * node + 1;
+                    }
+                }
+                return node - leaves;
+            }
+
+        private:
+            size_t n, leaves;
+            // tree[1] is the root, node k has the children 2k and 2k + 1, the priorities are the leaves
+            std::vector<double> tree;
+            random::xoshiro256 gen;
+    };
+}
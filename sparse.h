@@ -0,0 +1,178 @@
+/*
+ *  sparse.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace math {
+    /// <summary>
+    /// vector of the given size that stores only its nonzero entries as index/value pairs
+    /// </summary>
+    typedef struct sparseVector {
+        sparseVector(size_t _size = 0)
+            : size(_size) {}
+
+        /// <summary>
+        /// compress a dense vector, entries with |a| <= threshold are dropped
+        /// </summary>
+        sparseVector(const double* dense, size_t _size, double threshold = 0)
+            : size(_size) {
+            for (size_t i = 0; i < size; ++i) {
+                if (std::abs(dense[i]) > threshold) {
+                    index.push_back((uint32_t)i);
+                    value.push_back(dense[i]);
+                }
+            }
+        }
+
+        /// <summary>
+        /// number of stored (nonzero) entries
+        /// </summary>
+        size_t nonzeros() const {
+            return value.size();
+        }
+
+        size_t size;
+        std::vector<uint32_t> index;
+        std::vector<double> value;
+    } sparseVector;
+
+    /// <summary>
+    /// matrix in compressed sparse row (CSR) format
+    /// </summary>
+    typedef struct csrMatrix {
+        csrMatrix()
+            : rows(0), cols(0), rowptr(1, 0) {}
+
+        /// <summary>
+        /// compress a dense row-major matrix, entries with |a| <= threshold are dropped
+        /// </summary>
+        csrMatrix(const double* dense, size_t _rows, size_t _cols, double threshold = 0)
+            : rows(_rows), cols(_cols), rowptr(_rows + 1, 0) {
+            size_t nnz = 0;
+            for (size_t i = 0; i < rows * cols; ++i)
+                nnz += std::abs(dense[i]) > threshold;
+            colidx.reserve(nnz);
+            values.reserve(nnz);
+            for (size_t r = 0; r < rows; ++r) {
+                for (size_t c = 0; c < cols; ++c) {
+                    const double a = dense[r * cols + c];
+                    if (std::abs(a) > threshold) {
+                        colidx.push_back((uint32_t)c);
+                        values.push_back(a);
+                    }
+                }
+                rowptr[r + 1] = (uint32_t)values.size();
+            }
+        }
+
+        /// <summary>
+        /// one row per sparse vector (e.g. a batch of sparse inputs), all of the same size
+        /// </summary>
+        csrMatrix(const std::vector<sparseVector>& rowvectors)
+            : rows(rowvectors.size()), cols(rowvectors.empty() ? 0 : rowvectors[0].size), rowptr(rowvectors.size() + 1, 0) {
+            for (size_t r = 0; r < rows; ++r) {
+                colidx.insert(colidx.end(), rowvectors[r].index.begin(), rowvectors[r].index.end());
+                values.insert(values.end(), rowvectors[r].value.begin(), rowvectors[r].value.end());
+                rowptr[r + 1] = (uint32_t)values.size();
+            }
+        }
+
+        /// <summary>
+        /// y = A * x
+        /// </summary>
+        void spmv(const double* x, double* y) const {
+            for (size_t r = 0; r < rows; ++r) {
+                double sum = 0;
+                for (uint32_t k = rowptr[r]; k < rowptr[r + 1]; ++k)
+                    sum += values[k] * x[colidx[k]];
+                y[r] = sum;
+            }
+        }
+
+        /// <summary>
+        /// Y = A * X for a block of nbatch vectors. X is row-major [cols][nbatch],
+        /// Y is row-major [rows][nbatch], so the inner loop runs over contiguous memory.
+        /// </summary>
+        void spmm(const double* X, size_t nbatch, double* Y) const {
+            for (size_t r = 0; r < rows; ++r) {
+                double* y = Y + r * nbatch;
+                for (size_t b = 0; b < nbatch; ++b)
+                    y[b] = 0;
+                for (uint32_t k = rowptr[r]; k < rowptr[r + 1]; ++k) {
+                    const double a = values[k];
+                    const double* x = X + (size_t)colidx[k] * nbatch;
+                    for (size_t b = 0; b < nbatch; ++b)
+                        y[b] += a * x[b];
+                }
+            }
+        }
+
+        /// <summary>
+        /// number of stored (nonzero) entries
+        /// </summary>
+        size_t nonzeros() const {
+            return values.size();
+        }
+
+        /// <summary>
+        /// memory used by the compressed representation
+        /// </summary>
+        size_t bytes() const {
+            return rowptr.size() * sizeof(uint32_t) + colidx.size() * sizeof(uint32_t) + values.size() * sizeof(double);
+        }
+
+        /// <summary>
+        /// dimensions of the matrix
+        /// </summary>
+        size_t rows, cols;
+
+        /// <summary>
+        /// row start offsets, column indices and values of the nonzero entries
+        /// </summary>
+        std::vector<uint32_t> rowptr;
+        std::vector<uint32_t> colidx;
+        std::vector<double> values;
+    } csrMatrix;
+
+    /// <summary>
+    /// inference-only copy of a network whose hidden and output weights are stored sparse
+    /// (see supervisor::sparsify)
+    /// </summary>
+    typedef struct sparseNN {
+        sparseNN()
+            : ninputs(0), noutputs(0), nneurons(0) {}
+
+        /// <summary>
+        /// dense parameters of the input layer and the thresholds
+        /// </summary>
+        std::vector<double> iweights, itheta, htheta, otheta;
+
+        /// <summary>
+        /// sparse weight matrices
+        /// </summary>
+        csrMatrix hweights, oweights;
+
+        /// <summary>
+        /// scratch buffers of the forward pass
+        /// </summary>
+        mutable std::vector<double> ioutput, houtput;
+
+        /// <summary>
+        /// number of inputs, outputs and neurons
+        /// </summary>
+        size_t ninputs, noutputs, nneurons;
+
+        /// <summary>
+        /// memory used by the parameters
+        /// </summary>
+        size_t bytes() const {
+            return (iweights.size() + itheta.size() + htheta.size() + otheta.size()) * sizeof(double) + hweights.bytes() + oweights.bytes();
+        }
+    } sparseNN;
+}
@@ -0,0 +1,37 @@
+/*
+ *  sweep.cpp
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#include <iostream>
+#include <Eigen/Dense>
+
+#include "sweep.h"
+
+int main(int argc, char* args[]) {
+    // one network per task, no nested parallelism inside Eigen
+    Eigen::setNbThreads(1);
+
+    const size_t ninputs = 4, noutputs = 3;
+    const double xx[4][ninputs] = { {0, 0, 0, 0}, {0, 1, 0, 1}, {1, 0, 1, 0}, {1, 1, 1, 1} };
+    const double yy[4][noutputs] = { {0, 0, 0}, {0, 1, 0}, {1, 0, 0}, {1, 1, 0} };
+    std::vector<math::dataSet> dataset;
+    for (int s = 0; s < 4; ++s) {
+        math::dataSet d(ninputs, noutputs);
+        for (size_t i = 0; i < ninputs; ++i)
+            d.xx[i] = xx[s][i];
+        for (size_t i = 0; i < noutputs; ++i)
+            d.yy[i] = yy[s][i];
+        dataset.push_back(d);
+    }
+
+    math::adaptive fixed, adapt;
+    adapt.apply = true;
+    auto points = math::sweep::grid({5, 10, 20, 50, 100}, {0.3, 1, 3, 10, 30}, {fixed, adapt});
+
+    auto results = math::sweep::run(ninputs, noutputs, points, dataset);
+    math::sweep::print(std::cout, results);
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ *  sweep.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "nn.h"
+#include "random.h"
+#include "threadpool.h"
+
+namespace math {
+    /// <summary>
+    /// one point of a hyperparameter sweep
+    /// </summary>
+    typedef struct hyperparameters {
+        size_t nneurons = 50;
+        double learningrate = 1;
+        config cconfig;
+    } hyperparameters;
+
+    /// <summary>
+    /// result of one point of a hyperparameter sweep
+    /// </summary>
+    typedef struct sweepResult {
+        hyperparameters point;
+        // loss on the validation set after the last rung the point took part in
+        double loss = 0;
+        // number of training steps and the last rung the point took part in
+        size_t steps = 0, rung = 0;
+    } sweepResult;
+
+    // config of the successive halving
+    typedef struct sweepOptions {
+        // training steps of every point in the first rung
+        size_t minSteps = 100;
+        // after every rung only the best 1 / eta of the points survive and train eta times longer
+        size_t eta = 3;
+        // upper bound of the training steps of a single point
+        size_t maxSteps = 10000;
+    } sweepOptions;
+
+    /// <summary>
+    /// trains many configurations concurrently on the shared thread pool and discards the
+    /// poor ones early (successive halving)
+    /// </summary>
+    class sweep {
+        public:
+            /// <summary>
+            /// all combinations of the given values
+            /// </summary>
+            static std::vector<hyperparameters> grid(const std::vector<size_t>& nneurons, const std::vector<double>& learningrates, const std::vector<adaptive>& adaptives = { adaptive() }) {
+                std::vector<hyperparameters> points;
+                for (size_t n : nneurons)
+                    for (double lr : learningrates)
+                        for (const auto& a : adaptives) {
+                            hyperparameters hp;
+                            hp.nneurons = n;
+                            hp.learningrate = lr;
+                            hp.cconfig.adaptive = a;
+                            points.push_back(hp);
+                        }
+                return points;
+            }
+
+            /// <summary>
+            /// npoints random points: nneurons uniformly and the learning rate log-uniformly distributed,
+            /// the adaptive learning rate is applied to half of the points, with log-uniform thresholds
+            /// (lowerThreshold in [1e-4, 1e-2], upperThreshold in [1e-2, 1]) and increase in [1e-2, 0.5]
+            /// </summary>
+            static std::vector<hyperparameters> randomSample(size_t npoints, size_t minNeurons, size_t maxNeurons, double minLearningrate, double maxLearningrate, uint64_t seed = 0) {
+                random::xoshiro256 gen(seed);
+                std::vector<hyperparameters> points(npoints);
+                for (auto& hp : points) {
+                    hp.nneurons = minNeurons + (size_t)(gen.uniform() * (maxNeurons - minNeurons + 1));
+                    hp.learningrate = std::exp(gen.uniform(std::log(minLearningrate), std::log(maxLearningrate)));
+                    adaptive& a = hp.cconfig.adaptive;
+                    a.apply = gen.uniform() < 0.5;
+                    a.lowerThreshold = std::exp(gen.uniform(std::log(1e-4), std::log(1e-2)));
+                    a.upperThreshold = std::exp(gen.uniform(std::log(1e-2), std::log(1.0)));
+                    a.increase = std::exp(gen.uniform(std::log(1e-2), std::log(0.5)));
+                }
+                return points;
+            }
+
+            /// <summary>
+            /// train all points on the training set with successive halving and return the results
+            /// ranked by the validation loss (best first). If validation is empty the training set is used.
+            /// The points of a rung are trained concurrently on the pool; called from a worker of a
+            /// pool, they are trained one after the other on the calling thread.
+            /// </summary>
+            static std::vector<sweepResult> run(size_t ninputs, size_t noutputs, const std::vector<hyperparameters>& points,
+                const std::vector<dataSet>& training, const std::vector<dataSet>& validation = {}, const sweepOptions& opt = sweepOptions(),
+                threadPool& pool = threadPool::shared()) {
+                const std::vector<dataSet>& vset = validation.empty() ? training : validation;
+
+                // one network and workspace per point
+                std::vector<std::unique_ptr<candidate>> candidates;
+                for (const auto& hp : points)
+                    candidates.emplace_back(new candidate(ninputs, noutputs, hp));
+
+                std::vector<candidate*> alive;
+                for (auto& c : candidates)
+                    alive.push_back(c.get());
+
+                size_t budget = opt.minSteps;
+                for (size_t rung = 0; !alive.empty(); ++rung) {
+                    // one chunk per point
+                    pool.parallelFor(0, alive.size(), alive.size(), [&](size_t first, size_t last, size_t) {
+                        for (size_t i = first; i < last; ++i)
+                            alive[i]->advance(budget, rung, training, vset);
+                    });
+
+                    const size_t nkeep = alive.size() / std::max<size_t>(2, opt.eta);
+                    if (nkeep == 0 || budget >= opt.maxSteps)
+                        break;
+                    std::sort(alive.begin(), alive.end(), [](const candidate* a, const candidate* b) { return better(a->result, b->result); });
+                    alive.resize(nkeep);
+                    budget = std::min(budget * std::max<size_t>(2, opt.eta), opt.maxSteps);
+                }
+
+                std::vector<sweepResult> results;
+                for (const auto& c : candidates)
+                    results.push_back(c->result);
+                std::sort(results.begin(), results.end(), better);
+                return results;
+            }
+
+            /// <summary>
+            /// print the ranked results as a table, with the thresholds and the increase of the
+            /// adaptive learning rate where it is applied
+            /// </summary>
+            static void print(std::ostream& os, const std::vector<sweepResult>& results) {
+                os << std::setw(5) << "rank" << std::setw(10) << "nneurons" << std::setw(14) << "learningrate"
+                   << std::setw(10) << "adaptive" << std::setw(12) << "lower" << std::setw(12) << "upper" << std::setw(12) << "increase"
+                   << std::setw(8) << "rung" << std::setw(8) << "steps" << std::setw(14) << "loss" << std::endl;
+                for (size_t i = 0; i < results.size(); ++i) {
+                    const auto& r = results[i];
+                    const adaptive& a = r.point.cconfig.adaptive;
+                    os << std::setw(5) << i + 1 << std::setw(10) << r.point.nneurons
+                       << std::setw(14) << r.point.learningrate
+                       << std::setw(10) << (a.apply ? "yes" : "no");
+                    if (a.apply)
+                        os << std::setw(12) << a.lowerThreshold << std::setw(12) << a.upperThreshold << std::setw(12) << a.increase;
+                    else
+                        os << std::setw(12) << "-" << std::setw(12) << "-" << std::setw(12) << "-";
+                    os << std::setw(8) << r.rung << std::setw(8) << r.steps << std::setw(14) << r.loss << std::endl;
+                }
+            }
+
+        private:
+            /// <summary>
+            /// state of one point during the sweep
+            /// </summary>
+            typedef struct candidate {
+                candidate(size_t ninputs, size_t noutputs, const hyperparameters& hp)
+                    : nn(ninputs, noutputs, hp.nneurons, hp.cconfig), ws(supervisor::createWorkspace(nn)),
+                    mask(nn.ntotparameters, 1) {
+                    result.point = hp;
+                    supervisor::init(nn);
+                }
+
+                /// <summary>
+                /// train until the point has done budget steps in total and evaluate it
+                /// </summary>
+                void advance(size_t budget, size_t rung, const std::vector<dataSet>& training, const std::vector<dataSet>& validation) {
+                    for (; result.steps < budget; ++result.steps)
+                        supervisor::step(nn, training, result.point.learningrate, mask, ws);
+                    result.loss = supervisor::loss(nn, validation, ws);
+                    if (!std::isfinite(result.loss))
+                        result.loss = INFINITY;
+                    result.rung = rung;
+                }
+
+                math::nn nn;
+                workspace ws;
+                math::vector<double> mask;
+                sweepResult result;
+            } candidate;
+
+            /// <summary>
+            /// points that got further are better, within a rung the lower loss wins
+            /// </summary>
+            static bool better(const sweepResult& a, const sweepResult& b) {
+                if (a.rung != b.rung)
+                    return a.rung > b.rung;
+                return a.loss < b.loss;
+            }
+    };
+}
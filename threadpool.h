@@ -0,0 +1,160 @@
+/*
+ *  threadpool.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace math {
+    /// <summary>
+    /// fixed size pool of worker threads
+    /// </summary>
+    class threadPool {
+        public:
+            threadPool(size_t _nthreads = std::max(1u, std::thread::hardware_concurrency()))
+                : stop(false) {
+                for (size_t i = 0; i < _nthreads; ++i)
+                    workers.emplace_back([this] { work(); });
+            }
+
+            ~threadPool() {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    stop = true;
+                }
+                condition.notify_all();
+                for (auto& w : workers)
+                    w.join();
+            }
+
+            threadPool(const threadPool&) = delete;
+            threadPool& operator=(const threadPool&) = delete;
+
+            /// <summary>
+            /// pool shared by the whole process
+            /// </summary>
+            static threadPool& shared() {
+                static threadPool pool;
+                return pool;
+            }
+
+            /// <summary>
+            /// number of worker threads
+            /// </summary>
+            size_t size() const {
+                return workers.size();
+            }
+
+            /// <summary>
+            /// queue a task, the returned future holds its result
+            /// </summary>
+            template<typename F>
+            auto submit(F&& f) -> std::future<decltype(f())> {
+                typedef decltype(f()) result_type;
+                auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(f));
+                std::future<result_type> result = task->get_future();
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    tasks.emplace([task] { (*task)(); });
+                }
+                condition.notify_one();
+                return result;
+            }
+
+            /// <summary>
+            /// split [begin, end) into nchunks contiguous chunks and call func(first, last, chunk)
+            /// for each of them concurrently. The chunk boundaries only depend on the range and
+            /// nchunks, never on the number of threads. Blocks until all chunks are done.
+            /// </summary>
+            template<typename F>
+            void parallelFor(size_t begin, size_t end, size_t nchunks, F&& func) {
+                if (end <= begin)
+                    return;
+                nchunks = std::max<size_t>(1, std::min(nchunks, end - begin));
+                if (nchunks == 1 || onWorker()) {
+                    for (size_t c = 0; c < nchunks; ++c)
+                        func(chunkBegin(begin, end, nchunks, c), chunkBegin(begin, end, nchunks, c + 1), c);
+                    return;
+                }
+                std::vector<std::future<void>> futures;
+                futures.reserve(nchunks - 1);
+                for (size_t c = 1; c < nchunks; ++c)
+                    futures.push_back(submit([&func, begin, end, nchunks, c] {
+                        func(chunkBegin(begin, end, nchunks, c), chunkBegin(begin, end, nchunks, c + 1), c);
+                    }));
+                // the calling thread takes the first chunk itself. The queued chunks refer to func,
+                // so all of them are waited for before an exception (of any chunk) is rethrown.
+                std::exception_ptr error;
+                try {
+                    func(chunkBegin(begin, end, nchunks, 0), chunkBegin(begin, end, nchunks, 1), (size_t)0);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                for (auto& f : futures) {
+                    try {
+                        f.get();
+                    } catch (...) {
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                }
+                if (error)
+                    std::rethrow_exception(error);
+            }
+
+            /// <summary>
+            /// parallelFor with one chunk per worker thread
+            /// </summary>
+            template<typename F>
+            void parallelFor(size_t begin, size_t end, F&& func) {
+                parallelFor(begin, end, size(), std::forward<F>(func));
+            }
+
+        private:
+            static size_t chunkBegin(size_t begin, size_t end, size_t nchunks, size_t c) {
+                return begin + (end - begin) * c / nchunks;
+            }
+
+            /// <summary>
+            /// true if the calling thread is a worker of any pool. Nested parallelFor calls run
+            /// serially on the worker to avoid waiting on tasks queued behind themselves.
+            /// </summary>
+            static bool& onWorker() {
+                static thread_local bool worker = false;
+                return worker;
+            }
+
+            void work() {
+                onWorker() = true;
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        condition.wait(lock, [this] { return stop || !tasks.empty(); });
+                        if (stop && tasks.empty())
+                            return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            }
+
+            std::vector<std::thread> workers;
+            std::queue<std::function<void()>> tasks;
+            std::mutex mutex;
+            std::condition_variable condition;
+            bool stop;
+    };
+}
@@ -0,0 +1,254 @@
+/*
+ *  benchmark.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace math {
+    // config of a single benchmark
+    typedef struct benchmarkOptions {
+        // untimed runs before the trials
+        size_t warmups = 3;
+        // number of timed trials
+        size_t trials = 21;
+        // every trial repeats the function until at least this much time passed (ms)
+        double minTrialTime = 5;
+        // allowed slowdown of the median against the baseline median before a benchmark counts as
+        // regressed. On a shared machine short benchmarks scatter by more than this between
+        // processes, raise it there with SIMPLENN_PERF_TOLERANCE.
+        double tolerance = std::getenv("SIMPLENN_PERF_TOLERANCE") ? std::atof(std::getenv("SIMPLENN_PERF_TOLERANCE")) : 0.25;
+        // a regressed benchmark is measured again up to this many times and the new trials are
+        // pooled with the old ones. A burst of load on the machine is outvoted, a real slowdown
+        // persists.
+        size_t retries = 2;
+    } benchmarkOptions;
+
+    /// <summary>
+    /// time per call of one benchmark (ms): median and distribution-free 95% confidence
+    /// interval of the median over the trials
+    /// </summary>
+    typedef struct benchmarkResult {
+        std::string name;
+        double median = 0, low = 0, high = 0;
+        size_t trials = 0;
+    } benchmarkResult;
+
+    /// <summary>
+    /// performance regression harness. Every benchmark is compared against a baseline file;
+    /// times are stored relative to a calibration loop measured in the same run, so a baseline
+    /// recorded on one machine stays meaningful on a faster or slower one. A benchmark regressed
+    /// if its median is slower than the baseline median by more than the tolerance. A benchmark
+    /// missing from the baseline fails as well. Set SIMPLENN_UPDATE_BASELINE=1 to record missing
+    /// benchmarks and rewrite the baseline with the current results.
+    /// </summary>
+    class benchmark {
+        public:
+            benchmark(const std::string& _path, const benchmarkOptions& _options = benchmarkOptions())
+                : path(_path), options(_options), calibration(0), baselineCalibration(0) {
+                const char* update = std::getenv("SIMPLENN_UPDATE_BASELINE");
+                updating = update && std::string(update) != "0";
+                read();
+                calibration = measure("calibration", calibrationLoop).median;
+            }
+
+            /// <summary>
+            /// write the baseline file if SIMPLENN_UPDATE_BASELINE is set
+            /// </summary>
+            ~benchmark() {
+                if (updating)
+                    write();
+            }
+
+            /// <summary>
+            /// time per call of the calibration loop in this run (ms)
+            /// </summary>
+            double calibrationTime() const {
+                return calibration;
+            }
+
+            /// <summary>
+            /// time func and compare it with its baseline, returns false if it regressed or has
+            /// no baseline (unless the baseline is being updated)
+            /// </summary>
+            template<typename F>
+            bool run(const std::string& name, F&& func) {
+                // the clock of the core drifts during a run, calibrate right before every benchmark
+                calibration = measure("calibration", calibrationLoop).median;
+                std::vector<double> times = sample(func);
+                benchmarkResult r = summarize(name, times);
+                auto it = baseline.find(name);
+                const double expected = it != baseline.end() && baselineCalibration > 0 ? it->second * calibration / baselineCalibration : 0;
+                for (size_t retry = 0; expected > 0 && retry < options.retries && r.median > expected * (1 + options.tolerance); ++retry) {
+                    const std::vector<double> again = sample(func);
+                    times.insert(times.end(), again.begin(), again.end());
+                    r = summarize(name, times);
+                }
+                results[name] = r;
+
+                std::cout << std::left << std::setw(44) << name << std::right
+                          << std::setw(12) << r.median << " ms  [" << r.low << ", " << r.high << "]";
+                if (expected <= 0) {
+                    std::cout << (updating ? "  (recorded)" : "  NO BASELINE") << std::endl;
+                    return updating;
+                }
+                const double ratio = r.median / expected;
+                const bool ok = r.median <= expected * (1 + options.tolerance);
+                std::cout << "  x" << std::setprecision(3) << ratio << std::setprecision(6)
+                          << (ok ? "" : "  REGRESSION") << std::endl;
+                return ok;
+            }
+
+            /// <summary>
+            /// warmups, then options.trials timed trials of func
+            /// </summary>
+            template<typename F>
+            benchmarkResult measure(const std::string& name, F&& func) const {
+                return summarize(name, sample(func));
+            }
+
+        private:
+            /// <summary>
+            /// time per call of func in each trial (ms)
+            /// </summary>
+            template<typename F>
+            std::vector<double> sample(F& func) const {
+                for (size_t w = 0; w < options.warmups; ++w)
+                    func();
+
+                // calls per trial such that one trial takes at least minTrialTime
+                size_t ncalls = 1;
+                while (time(func, ncalls) < options.minTrialTime && ncalls < (1u << 30))
+                    ncalls *= 2;
+
+                std::vector<double> times(options.trials);
+                for (auto& t : times)
+                    t = time(func, ncalls) / ncalls;
+                return times;
+            }
+
+            static benchmarkResult summarize(const std::string& name, std::vector<double> times) {
+                std::sort(times.begin(), times.end());
+
+                // ranks of the confidence interval of the median (normal approximation of the binomial)
+                const size_t n = times.size();
+                const double halfWidth = 0.98 * std::sqrt((double)n);
+                const size_t lo = (size_t)std::max(0.0, std::floor(0.5 * n - halfWidth));
+                const size_t hi = std::min(n - 1, (size_t)std::ceil(0.5 * n + halfWidth) - 1);
+
+                benchmarkResult r;
+                r.name = name;
+                r.trials = n;
+                r.median = n % 2 ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+                r.low = times[lo];
+                r.high = times[hi];
+                return r;
+            }
+
+            template<typename F>
+            static double time(F& func, size_t ncalls) {
+                auto t_start = std::chrono::high_resolution_clock::now();
+                for (size_t c = 0; c < ncalls; ++c)
+                    func();
+                auto t_end = std::chrono::high_resolution_clock::now();
+                return std::chrono::duration<double, std::milli>(t_end - t_start).count();
+            }
+
+            /// <summary>
+            /// dependent chain of floating point operations, scales with the clock of the core
+            /// </summary>
+            static void calibrationLoop() {
+                volatile double seed = 1.000001;
+                double x = seed;
+                for (int i = 0; i < 100000; ++i)
+                    x = x * seed + 1e-9;
+                seed = x;
+            }
+
+            /// <summary>
+            /// the baseline is a flat json object: "calibration" and one entry per benchmark
+            /// with its median ("name": {"median": ..., "low": ..., "high": ...})
+            /// </summary>
+            void read() {
+                std::ifstream is(path);
+                if (!is)
+                    return;
+                std::stringstream ss;
+                ss << is.rdbuf();
+                const std::string json = ss.str();
+
+                size_t pos = 0;
+                std::string key;
+                while (nextString(json, pos, key)) {
+                    const size_t colon = json.find(':', pos);
+                    if (colon == std::string::npos)
+                        break;
+                    pos = colon + 1;
+                    while (pos < json.size() && std::isspace((unsigned char)json[pos]))
+                        ++pos;
+                    if (key == "calibration") {
+                        baselineCalibration = std::strtod(json.c_str() + pos, nullptr);
+                    } else if (pos < json.size() && json[pos] == '{') {
+                        const size_t end = json.find('}', pos);
+                        const size_t median = json.find("\"median\"", pos);
+                        if (median != std::string::npos && median < end)
+                            baseline[key] = std::strtod(json.c_str() + json.find(':', median) + 1, nullptr);
+                        pos = end;
+                    }
+                }
+            }
+
+            static bool nextString(const std::string& json, size_t& pos, std::string& value) {
+                const size_t begin = json.find('"', pos);
+                if (begin == std::string::npos)
+                    return false;
+                const size_t end = json.find('"', begin + 1);
+                if (end == std::string::npos)
+                    return false;
+                value = json.substr(begin + 1, end - begin - 1);
+                pos = end + 1;
+                return true;
+            }
+
+            /// <summary>
+            /// merge the current results into the baseline and write it
+            /// </summary>
+            void write() const {
+                std::map<std::string, benchmarkResult> merged;
+                for (const auto& b : baseline) {
+                    benchmarkResult r;
+                    r.median = r.low = r.high = b.second * (baselineCalibration > 0 ? calibration / baselineCalibration : 1);
+                    merged[b.first] = r;
+                }
+                for (const auto& r : results)
+                    merged[r.first] = r.second;
+
+                std::ofstream os(path);
+                os << std::setprecision(6) << "{\n    \"calibration\": " << calibration;
+                for (const auto& r : merged)
+                    os << ",\n    \"" << r.first << "\": { \"median\": " << r.second.median
+                       << ", \"low\": " << r.second.low << ", \"high\": " << r.second.high << " }";
+                os << "\n}\n";
+            }
+
+            std::string path;
+            benchmarkOptions options;
+            double calibration, baselineCalibration;
+            bool updating;
+            std::map<std::string, double> baseline;
+            std::map<std::string, benchmarkResult> results;
+    };
+}
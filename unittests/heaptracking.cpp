@@ -0,0 +1,110 @@
+/*
+ *  heaptracking.cpp
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+// replaces the global operator new and delete (and, with glibc, malloc and its relatives) of the
+// program it is linked into, so that heapTracker counts every allocation
+#include <cstddef>
+#include <new>
+
+#include "accounting.h"
+
+void* operator new(size_t size) {
+    return math::heapTracker::allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return math::heapTracker::allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    math::heapTracker::deallocate(p);
+}
+
+void operator delete[](void* p) noexcept {
+    math::heapTracker::deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    math::heapTracker::deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    math::heapTracker::deallocate(p);
+}
+
+#ifdef __GLIBC__
+    #include <cerrno>
+    #include <malloc.h>
+
+    extern "C" {
+        void* __libc_calloc(size_t n, size_t size);
+        void* __libc_realloc(void* p, size_t size);
+        void* __libc_memalign(size_t alignment, size_t size);
+        void* __libc_valloc(size_t size);
+        void* __libc_pvalloc(size_t size);
+    }
+
+    namespace {
+        // glibc lets the program replace malloc and its relatives, blocks are counted with their usable size
+        void* counted(void* p) {
+            if (p)
+                math::heapTracker::added(malloc_usable_size(p));
+            return p;
+        }
+    }
+
+    extern "C" {
+        void* malloc(size_t size) noexcept {
+            return counted(__libc_malloc(size));
+        }
+
+        void* calloc(size_t n, size_t size) noexcept {
+            return counted(__libc_calloc(n, size));
+        }
+
+        void* realloc(void* p, size_t size) noexcept {
+            const size_t old = p ? malloc_usable_size(p) : 0;
+            void* q = __libc_realloc(p, size);
+            // on failure p stays valid, realloc(p, 0) frees it
+            if (q || size == 0)
+                math::heapTracker::removed(old);
+            return counted(q);
+        }
+
+        void* memalign(size_t alignment, size_t size) noexcept {
+            return counted(__libc_memalign(alignment, size));
+        }
+
+        void* aligned_alloc(size_t alignment, size_t size) noexcept {
+            return counted(__libc_memalign(alignment, size));
+        }
+
+        int posix_memalign(void** p, size_t alignment, size_t size) noexcept {
+            if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+                return EINVAL;
+            void* q = counted(__libc_memalign(alignment, size));
+            if (!q)
+                return ENOMEM;
+            *p = q;
+            return 0;
+        }
+
+        void* valloc(size_t size) noexcept {
+            return counted(__libc_valloc(size));
+        }
+
+        void* pvalloc(size_t size) noexcept {
+            return counted(__libc_pvalloc(size));
+        }
+
+        void free(void* p) noexcept {
+            if (!p)
+                return;
+            math::heapTracker::removed(malloc_usable_size(p));
+            __libc_free(p);
+        }
+    }
+#endif
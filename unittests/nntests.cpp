@@ -0,0 +1,1611 @@
+// the Makefile builds all unittests with EIGEN_RUNTIME_NO_MALLOC: Eigen asserts on heap
+// allocations while set_is_malloc_allowed(false)
+#ifndef EIGEN_RUNTIME_NO_MALLOC
+    #error "the unittests need -D EIGEN_RUNTIME_NO_MALLOC"
+#endif
+// heaptracking.cpp counts all allocations of the test binary (operator new and, with glibc,
+// malloc) and tracks the heap in use
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+#include "distributed.h"
+#include "hogwild.h"
+#include "inferencecache.h"
+#include "modelfile.h"
+#include "modelhandle.h"
+#include "online.h"
+#include "predict.h"
+#include "nn.h"
+#include "sweep.h"
+#include "validation.h"
+
+using namespace math;
+
+TEST(NNTest, InitIsReproducible) {
+    config c;
+    c.init.seed = 1234;
+    nn nn1(4, 3, 50, c), nn2(4, 3, 50, c);
+    supervisor::init(nn1);
+    supervisor::init(nn2);
+    for (size_t i = 0; i < nn1.ntotparameters; ++i)
+        EXPECT_EQ(nn1.parameters[i], nn2.parameters[i]);
+
+    supervisor::init(nn2, 4321);
+    size_t ndiffer = 0;
+    for (size_t i = 0; i < nn1.ntotparameters; ++i)
+        ndiffer += nn1.parameters[i] != nn2.parameters[i];
+    EXPECT_GT(ndiffer, nn1.ntotparameters / 2);
+}
+
+TEST(NNTest, InitXavier) {
+    config c;
+    c.init.method = initialization::xavier;
+    const size_t ninputs = 4, noutputs = 3, nneurons = 50;
+    nn nn(ninputs, noutputs, nneurons, c);
+    supervisor::init(nn);
+
+    const double hlimit = std::sqrt(6.0 / (ninputs + nneurons));
+    const double olimit = std::sqrt(6.0 / (nneurons + noutputs));
+    for (size_t i = 0; i < ninputs; ++i) {
+        EXPECT_EQ(1, nn.iweights[i]);
+        EXPECT_EQ(0, nn.itheta[i]);
+    }
+    // hidden neurons must not be identical
+    EXPECT_NE(nn.hweights(0, 0), nn.hweights(1, 0));
+    for (size_t r = 0; r < nneurons; ++r) {
+        EXPECT_EQ(0, nn.htheta[r]);
+        for (size_t c = 0; c < ninputs; ++c)
+            EXPECT_LE(std::abs(nn.hweights(r, c)), hlimit);
+    }
+    for (size_t r = 0; r < noutputs; ++r)
+        for (size_t c = 0; c < nneurons; ++c)
+            EXPECT_LE(std::abs(nn.oweights(r, c)), olimit);
+}
+
+TEST(NNTest, InitLargeModelParallel) {
+    config c;
+    c.init.method = initialization::he;
+    nn nn(1000, 10, 2000, c);
+    auto t_start = std::chrono::high_resolution_clock::now();
+    supervisor::init(nn);
+    auto t_end = std::chrono::high_resolution_clock::now();
+    std::cout << "init of " << nn.ntotparameters << " parameters took "
+              << std::chrono::duration<double, std::milli>(t_end - t_start).count() << "ms" << std::endl;
+
+    double sum = 0, sum2 = 0;
+    for (size_t i = 2 * 1000; i < 2 * 1000 + 2000 * 1000; ++i) {
+        sum += nn.parameters[i];
+        sum2 += nn.parameters[i] * nn.parameters[i];
+    }
+    const double n = 2000 * 1000;
+    // uniform in [-l, l] has variance l^2 / 3 = 2 / fanin
+    EXPECT_NEAR(0, sum / n, 1e-3);
+    EXPECT_NEAR(2.0 / 1000, sum2 / n, 1e-4);
+}
+
+TEST(NNTest, RandomStreamsDiffer) {
+    random::xoshiro256 a(1, 0), b(1, 1), c(1, 0);
+    EXPECT_NE(a(), b());
+    a = random::xoshiro256(1, 0);
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(a(), c());
+
+    double mean = 0;
+    for (int i = 0; i < 100000; ++i) {
+        double u = b.uniform();
+        EXPECT_GE(u, 0);
+        EXPECT_LT(u, 1);
+        mean += u;
+    }
+    EXPECT_NEAR(0.5, mean / 100000, 0.01);
+}
+
+TEST(NNTest, ParallelForWaitsBeforeRethrowing) {
+    threadPool pool(4);
+    std::atomic<size_t> finished{ 0 };
+    EXPECT_THROW(pool.parallelFor(0, 4, 4, [&](size_t first, size_t, size_t) {
+        if (first == 0)
+            throw std::runtime_error("chunk 0");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ++finished;
+    }), std::runtime_error);
+    // all other chunks are done when the exception arrives
+    EXPECT_EQ(3u, finished.load());
+}
+
+static std::vector<dataSet> xorLikeDataset() {
+    std::vector<dataSet> dataset;
+    const double xx[4][4] = { {0, 0, 0, 0}, {0, 1, 0, 1}, {1, 0, 1, 0}, {1, 1, 1, 1} };
+    const double yy[4][3] = { {0, 0, 0}, {0, 1, 0}, {1, 0, 0}, {1, 1, 0} };
+    for (int s = 0; s < 4; ++s) {
+        dataSet d(4, 3);
+        for (int i = 0; i < 4; ++i)
+            d.xx[i] = xx[s][i];
+        for (int i = 0; i < 3; ++i)
+            d.yy[i] = yy[s][i];
+        dataset.push_back(d);
+    }
+    return dataset;
+}
+
+TEST(NNTest, PruneToSparsity) {
+    nn nn(16, 4, 32);
+    supervisor::init(nn);
+    auto mask = supervisor::pruneToSparsity(nn, 0.8);
+
+    size_t nweights = 32 * 16 + 4 * 32, nzero = 0;
+    for (size_t r = 0; r < 32; ++r)
+        for (size_t c = 0; c < 16; ++c)
+            nzero += nn.hweights(r, c) == 0;
+    for (size_t r = 0; r < 4; ++r)
+        for (size_t c = 0; c < 32; ++c)
+            nzero += nn.oweights(r, c) == 0;
+    EXPECT_EQ((size_t)std::llround(0.8 * nweights), nzero);
+
+    size_t nmasked = 0;
+    for (size_t i = 0; i < nn.ntotparameters; ++i) {
+        nmasked += mask[i] == 0;
+        if (mask[i] == 0) {
+            EXPECT_EQ(0, nn.parameters[i]);
+        }
+    }
+    EXPECT_EQ(nzero, nmasked);
+}
+
+TEST(NNTest, SparseInferenceMatchesDense) {
+    const size_t ninputs = 256, noutputs = 16, nneurons = 512, nbatch = 64;
+    nn nn(ninputs, noutputs, nneurons);
+    supervisor::init(nn);
+    supervisor::pruneToSparsity(nn, 0.9);
+    sparseNN snn = supervisor::sparsify(nn);
+    EXPECT_LT(snn.bytes(), nn.ntotparameters * sizeof(double) / 2);
+
+    random::xoshiro256 gen(7);
+    std::vector<math::vector<double>> xx(nbatch, math::vector<double>(ninputs));
+    for (auto& x : xx)
+        for (size_t i = 0; i < ninputs; ++i)
+            x[i] = gen.uniform();
+
+    std::vector<math::vector<double>> yy;
+    supervisor::calculateNN(xx, snn, yy);
+    math::vector<double> y(noutputs);
+    for (size_t b = 0; b < nbatch; ++b) {
+        supervisor::calculateNN(xx[b], nn);
+        supervisor::calculateNN(xx[b], snn, y);
+        for (size_t i = 0; i < noutputs; ++i) {
+            EXPECT_NEAR(nn.ooutput[i], y[i], 1e-12);
+            EXPECT_NEAR(nn.ooutput[i], yy[b][i], 1e-12);
+        }
+    }
+
+    const size_t nexec = 20;
+    auto t_start = std::chrono::high_resolution_clock::now();
+    for (size_t e = 0; e < nexec; ++e)
+        for (size_t b = 0; b < nbatch; ++b)
+            supervisor::calculateNN(xx[b], nn);
+    auto t_end = std::chrono::high_resolution_clock::now();
+    std::cout << "dense inference took " << std::chrono::duration<double, std::milli>(t_end - t_start).count() / nexec << "ms" << std::endl;
+    t_start = std::chrono::high_resolution_clock::now();
+    for (size_t e = 0; e < nexec; ++e)
+        for (size_t b = 0; b < nbatch; ++b)
+            supervisor::calculateNN(xx[b], snn, y);
+    t_end = std::chrono::high_resolution_clock::now();
+    std::cout << "sparse inference took " << std::chrono::duration<double, std::milli>(t_end - t_start).count() / nexec << "ms" << std::endl;
+    t_start = std::chrono::high_resolution_clock::now();
+    for (size_t e = 0; e < nexec; ++e)
+        supervisor::calculateNN(xx, snn, yy);
+    t_end = std::chrono::high_resolution_clock::now();
+    std::cout << "sparse batch inference took " << std::chrono::duration<double, std::milli>(t_end - t_start).count() / nexec << "ms" << std::endl;
+}
+
+TEST(NNTest, FineTuneKeepsPrunedWeights) {
+    nn nn(4, 3, 20);
+    supervisor::init(nn);
+    auto dataset = xorLikeDataset();
+    auto mask = supervisor::pruneToSparsity(nn, 0.5);
+    supervisor::train(nn, dataset, 0.1, 15, mask);
+    for (size_t i = 0; i < nn.ntotparameters; ++i) {
+        if (mask[i] == 0) {
+            EXPECT_EQ(0, nn.parameters[i]);
+        }
+    }
+}
+
+TEST(NNTest, LowRankFactorization) {
+    const size_t ninputs = 128, noutputs = 8, nneurons = 256, truerank = 4;
+    nn nn(ninputs, noutputs, nneurons);
+    supervisor::init(nn);
+
+    // hidden weights of rank 4 plus a little noise
+    random::xoshiro256 gen(3);
+    matrix<double> a(nneurons, truerank), b(truerank, ninputs);
+    for (size_t r = 0; r < nneurons; ++r)
+        for (size_t k = 0; k < truerank; ++k)
+            a(r, k) = gen.uniform(-0.3, 0.3);
+    for (size_t k = 0; k < truerank; ++k)
+        for (size_t c = 0; c < ninputs; ++c)
+            b(k, c) = gen.uniform(-0.3, 0.3);
+    for (size_t r = 0; r < nneurons; ++r)
+        for (size_t c = 0; c < ninputs; ++c) {
+            nn.hweights(r, c) = gen.uniform(-1e-4, 1e-4);
+            for (size_t k = 0; k < truerank; ++k)
+                nn.hweights(r, c) += a(r, k) * b(k, c);
+        }
+
+    std::vector<dataSet> dataset;
+    for (int s = 0; s < 32; ++s) {
+        dataSet d(ninputs, noutputs);
+        for (size_t i = 0; i < ninputs; ++i)
+            d.xx[i] = gen.uniform();
+        dataset.push_back(d);
+    }
+
+    lowRank config;
+    config.energy = 0.999;
+    config.output = false;
+    std::vector<lowRankReport> report;
+    lowRankNN lnn = supervisor::factorize(nn, config, dataset, report);
+    EXPECT_TRUE(lnn.hweights.factored);
+    EXPECT_FALSE(lnn.oweights.factored);
+    EXPECT_EQ(truerank, lnn.hweights.rank);
+    EXPECT_LT(lnn.hweights.flops(), nneurons * ninputs / 10);
+
+    ASSERT_EQ(1, report.size());
+    EXPECT_EQ("hidden", report[0].layer);
+    EXPECT_NEAR(report[0].denseLoss, report[0].factoredLoss, 1e-3);
+    std::cout << "hidden layer: rank " << report[0].rank << ", energy " << report[0].energy
+              << ", loss " << report[0].denseLoss << " -> " << report[0].factoredLoss
+              << ", speedup " << report[0].speedup << std::endl;
+
+    math::vector<double> yy(noutputs);
+    for (const auto& d : dataset) {
+        supervisor::calculateNN(d.xx, nn);
+        supervisor::calculateNN(d.xx, lnn, yy);
+        for (size_t i = 0; i < noutputs; ++i)
+            EXPECT_NEAR(nn.ooutput[i], yy[i], 1e-3);
+    }
+
+    // fixed rank
+    config.rank = 2;
+    lnn = supervisor::factorize(nn, config);
+    EXPECT_EQ(2, lnn.hweights.rank);
+}
+
+TEST(NNTest, GradientMatchesFiniteDifferences) {
+    nn nn(4, 3, 10);
+    supervisor::init(nn);
+    auto dataset = xorLikeDataset();
+    workspace ws = supervisor::createWorkspace(nn);
+    supervisor::gradient(nn, dataset, ws);
+    std::vector<double> analytic(ws.gradient, ws.gradient + nn.ntotparameters);
+
+    const double h = 1e-6;
+    for (size_t i = 0; i < nn.ntotparameters; ++i) {
+        const double save = nn.parameters[i];
+        nn.parameters[i] = save + h;
+        const double lp = supervisor::gradient(nn, dataset, ws);
+        nn.parameters[i] = save - h;
+        const double lm = supervisor::gradient(nn, dataset, ws);
+        nn.parameters[i] = save;
+        EXPECT_NEAR((lp - lm) / (2 * h), analytic[i], 1e-6);
+    }
+}
+
+TEST(NNTest, TrainingStepDoesNotAllocate) {
+    nn nn(4, 3, 50);
+    supervisor::init(nn);
+    auto dataset = xorLikeDataset();
+    math::vector<double> mask(nn.ntotparameters, 1);
+    workspace ws = supervisor::createWorkspace(nn);
+
+    const double lf0 = supervisor::step(nn, dataset, 1, mask, ws);
+    const size_t before = heapTracker::allocations();
+    Eigen::internal::set_is_malloc_allowed(false);
+    double lf = 0;
+    for (int i = 0; i < 100; ++i)
+        lf = supervisor::step(nn, dataset, 1, mask, ws);
+    Eigen::internal::set_is_malloc_allowed(true);
+    EXPECT_EQ(before, heapTracker::allocations());
+    EXPECT_LT(lf, lf0);
+}
+
+TEST(NNTest, TransferTableErrorBound) {
+    for (double maxError : {1e-2, 1e-4, 1e-6}) {
+        const transferTable sigmoid = transferTable::sigmoid(maxError);
+        const transferTable tanh = transferTable::tanh(maxError);
+        double sigmoidError = 0, tanhError = 0;
+        // dense sweep over and beyond the tabulated interval, including the grid points
+        for (double x = -60; x <= 60; x += 1e-3) {
+            sigmoidError = std::max(sigmoidError, std::abs(sigmoid(x) - 1 / (1 + std::exp(-x))));
+            tanhError = std::max(tanhError, std::abs(tanh(x) - std::tanh(x)));
+        }
+        for (double x : {(double)-INFINITY, -1e300, -sigmoid.xmax, 0.0, sigmoid.xmax, 1e300, (double)INFINITY}) {
+            sigmoidError = std::max(sigmoidError, std::abs(sigmoid(x) - 1 / (1 + std::exp(-x))));
+            tanhError = std::max(tanhError, std::abs(tanh(x) - std::tanh(x)));
+        }
+        std::cout << "maxError = " << maxError << ": sigmoid " << sigmoidError << " (" << sigmoid.values.size()
+                  << " entries), tanh " << tanhError << " (" << tanh.values.size() << " entries)" << std::endl;
+        EXPECT_LE(sigmoidError, maxError);
+        EXPECT_LE(tanhError, maxError);
+    }
+}
+
+TEST(NNTest, TransferTableKeepsNaN) {
+    const transferTable table = transferTable::sigmoid(1e-4);
+    EXPECT_TRUE(std::isnan(table(NAN)));
+    EXPECT_TRUE(std::isnan(table(-NAN)));
+
+    // every kernel variant, NaN in the vectorized part and in the remainder
+    for (int i = cpu::generic; i <= cpu::detect(); ++i) {
+        std::vector<double> y(19);
+        for (size_t k = 0; k < y.size(); ++k)
+            y[k] = k % 3 == 0 ? NAN : k - 9.0;
+        cpu::kernels((cpu::isa)i).interpolate(table, y.data(), y.size());
+        for (size_t k = 0; k < y.size(); ++k) {
+            if (k % 3 == 0) {
+                EXPECT_TRUE(std::isnan(y[k])) << cpu::name((cpu::isa)i) << " " << k;
+            } else {
+                EXPECT_NEAR(1 / (1 + std::exp(-(k - 9.0))), y[k], 1e-4);
+            }
+        }
+    }
+}
+
+TEST(NNTest, ApproximateInference) {
+    const size_t ninputs = 32, noutputs = 4, nneurons = 64, nsamples = 256;
+    config exact, approx;
+    approx.approx.apply = true;
+    approx.approx.maxError = 1e-5;
+    nn nn1(ninputs, noutputs, nneurons, exact), nn2(ninputs, noutputs, nneurons, approx);
+    supervisor::init(nn1);
+    supervisor::init(nn2);
+
+    random::xoshiro256 gen(11);
+    std::vector<math::vector<double>> xx(nsamples, math::vector<double>(ninputs));
+    for (auto& x : xx)
+        for (size_t i = 0; i < ninputs; ++i)
+            x[i] = gen.uniform(-2, 2);
+
+    workspace ws1 = supervisor::createWorkspace(nn1), ws2 = supervisor::createWorkspace(nn2);
+    for (const auto& x : xx) {
+        supervisor::calculateNN(x, nn1, ws1);
+        supervisor::calculateNN(x, nn2, ws2);
+        for (size_t i = 0; i < noutputs; ++i)
+            EXPECT_NEAR(ws1.ooutput[i], ws2.ooutput[i], 1e-3);
+    }
+}
+
+TEST(NNTest, SweepSuccessiveHalving) {
+    auto dataset = xorLikeDataset();
+    auto points = sweep::grid({4, 20}, {0.01, 1, 10}, {adaptive()});
+    ASSERT_EQ(6, points.size());
+
+    sweepOptions opt;
+    opt.minSteps = 20;
+    opt.eta = 2;
+    opt.maxSteps = 500;
+    auto results = sweep::run(4, 3, points, dataset, {}, opt);
+    sweep::print(std::cout, results);
+
+    ASSERT_EQ(6, results.size());
+    // 6 -> 3 -> 1 points
+    EXPECT_EQ(2, results[0].rung);
+    EXPECT_EQ(80, results[0].steps);
+    EXPECT_EQ(1, results[1].rung);
+    EXPECT_EQ(1, results[2].rung);
+    for (size_t i = 3; i < 6; ++i) {
+        EXPECT_EQ(0, results[i].rung);
+        EXPECT_EQ(20, results[i].steps);
+    }
+    for (size_t i = 1; i < 6; ++i) {
+        if (results[i].rung == results[i - 1].rung) {
+            EXPECT_LE(results[i - 1].loss, results[i].loss);
+        }
+    }
+    // the tiny learning rate never survives the first rung
+    for (const auto& r : results) {
+        if (r.point.learningrate == 0.01) {
+            EXPECT_EQ(0, r.rung);
+        }
+    }
+
+    // same result, independent of the number of threads
+    threadPool pool(1);
+    auto serial = sweep::run(4, 3, points, dataset, {}, opt, pool);
+    for (size_t i = 0; i < 6; ++i)
+        EXPECT_EQ(results[i].loss, serial[i].loss);
+
+    // called from a worker of the pool, the points are trained inline instead of waiting on the pool
+    auto nested = pool.submit([&] { return sweep::run(4, 3, points, dataset, {}, opt, pool); }).get();
+    for (size_t i = 0; i < 6; ++i)
+        EXPECT_EQ(results[i].loss, nested[i].loss);
+}
+
+TEST(NNTest, SweepRandomSample) {
+    auto points = sweep::randomSample(50, 4, 20, 0.01, 10, 3);
+    ASSERT_EQ(50, points.size());
+    size_t napply = 0;
+    std::set<double> lower, upper, increase;
+    for (const auto& hp : points) {
+        const adaptive& a = hp.cconfig.adaptive;
+        EXPECT_GE(hp.nneurons, 4u);
+        EXPECT_LE(hp.nneurons, 20u);
+        EXPECT_LT(a.lowerThreshold, a.upperThreshold);
+        napply += a.apply;
+        lower.insert(a.lowerThreshold);
+        upper.insert(a.upperThreshold);
+        increase.insert(a.increase);
+    }
+    // the thresholds of the adaptive learning rate are swept as well
+    EXPECT_GT(napply, 0u);
+    EXPECT_LT(napply, 50u);
+    EXPECT_EQ(50u, lower.size());
+    EXPECT_EQ(50u, upper.size());
+    EXPECT_EQ(50u, increase.size());
+
+    // the printed table holds the thresholds of every point with an adaptive learning rate
+    std::vector<sweepResult> results(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        results[i].point = points[i];
+    std::stringstream table;
+    sweep::print(table, results);
+    for (const auto& hp : points) {
+        const adaptive& a = hp.cconfig.adaptive;
+        if (a.apply) {
+            std::stringstream values;
+            values << std::setw(12) << a.lowerThreshold << std::setw(12) << a.upperThreshold << std::setw(12) << a.increase;
+            EXPECT_NE(std::string::npos, table.str().find(values.str()));
+        }
+    }
+}
+
+TEST(NNTest, EnsembleMatchesSingleNetworks) {
+    const size_t nmembers = 5;
+    ensemble ens(4, 3, 10, nmembers);
+    supervisor::init(ens);
+
+    // every member gets its own dataset
+    std::vector<std::vector<dataSet>> datasets(nmembers, xorLikeDataset());
+    for (size_t k = 0; k < nmembers; ++k)
+        for (auto& d : datasets[k])
+            d.yy[2] = (double)k / nmembers;
+
+    std::vector<double> g;
+    supervisor::gradient(ens, datasets, g);
+    nn nn(4, 3, 10);
+    workspace ws = supervisor::createWorkspace(nn);
+    for (size_t k = 0; k < nmembers; ++k) {
+        supervisor::getMember(ens, k, nn);
+        supervisor::gradient(nn, datasets[k], ws);
+        for (size_t i = 0; i < nn.ntotparameters; ++i)
+            EXPECT_NEAR(ws.gradient[i], g[k * ens.nparameters + i], 1e-12);
+    }
+
+    // the ensemble output is the average of the member outputs
+    math::vector<double> x = {1, 0, 1, 0}, yy;
+    supervisor::calculateNN(x, ens, yy);
+    std::vector<double> average(3, 0);
+    for (size_t k = 0; k < nmembers; ++k) {
+        supervisor::getMember(ens, k, nn);
+        supervisor::calculateNN(x, nn);
+        for (size_t i = 0; i < 3; ++i)
+            average[i] += nn.ooutput[i] / nmembers;
+    }
+    for (size_t i = 0; i < 3; ++i)
+        EXPECT_NEAR(average[i], yy[i], 1e-12);
+
+    // inference does not touch the training buffers and can run concurrently
+    std::vector<std::thread> threads;
+    std::vector<math::vector<double>> concurrent(4);
+    for (size_t t = 0; t < 4; ++t)
+        threads.emplace_back([&, t] { supervisor::calculateNN(x, ens, concurrent[t]); });
+    for (auto& t : threads)
+        t.join();
+    for (size_t t = 0; t < 4; ++t)
+        for (size_t i = 0; i < 3; ++i)
+            EXPECT_EQ(yy[i], concurrent[t][i]);
+    for (size_t k = 0; k < nmembers; ++k)
+        EXPECT_EQ(datasets[k].size(), (size_t)ens.scratch[k].xx.cols());
+}
+
+TEST(NNTest, EnsembleTrainsInLockstep) {
+    const size_t nmembers = 16;
+    ensemble ens(4, 3, 50, nmembers);
+    supervisor::init(ens);
+    std::vector<std::vector<dataSet>> datasets(nmembers, xorLikeDataset());
+    for (size_t k = 0; k < nmembers; ++k)
+        for (auto& d : datasets[k])
+            d.yy[2] = 0.5 * d.xx[k % 4];
+
+    supervisor::train(ens, datasets, 0.01, 5);
+    for (size_t k = 0; k < nmembers; ++k)
+        EXPECT_LE(ens.losses[k], 0.01);
+}
+
+TEST(NNTest, CompiledNetworkMatchesOriginal) {
+    const size_t ninputs = 16, noutputs = 4, nneurons = 32;
+    nn nn(ninputs, noutputs, nneurons);
+    supervisor::init(nn);
+    for (size_t i = 0; i < ninputs; ++i)
+        nn.itheta[i] = 0.1 * i;
+    for (size_t j = 0; j < nneurons; ++j)
+        nn.htheta[j] = 0.01 * j;
+    // constant inputs
+    nn.iweights[3] = 0;
+    nn.iweights[7] = 0;
+    // constant neurons
+    for (size_t i = 0; i < ninputs; ++i) {
+        nn.hweights(5, i) = 0;
+        nn.hweights(6, i) = i == 3 || i == 7 ? 0.5 : 0;
+    }
+    // dead neurons
+    for (size_t k = 0; k < noutputs; ++k) {
+        nn.oweights(k, 10) = 0;
+        nn.oweights(k, 11) = 0;
+    }
+
+    compiledNN cnn = supervisor::compile(nn);
+    EXPECT_EQ(ninputs - 2, cnn.nlinputs);
+    EXPECT_EQ(nneurons - 4, cnn.nlneurons);
+
+    random::xoshiro256 gen(5);
+    math::vector<double> xx(ninputs), yy;
+    for (int s = 0; s < 100; ++s) {
+        for (size_t i = 0; i < ninputs; ++i)
+            xx[i] = gen.uniform(-1, 1);
+        supervisor::calculateNN(xx, nn);
+        supervisor::calculateNN(xx, cnn, yy);
+        for (size_t k = 0; k < noutputs; ++k)
+            EXPECT_NEAR(nn.ooutput[k], yy[k], 1e-12);
+    }
+}
+
+/// <summary>
+/// export the network, compile the header with a small driver and compare its outputs with calculateNN
+/// </summary>
+static void checkGeneratedHeader(const nn& nn, const codegenOptions& options, const std::string& tag) {
+    const std::string dir = testing::TempDir();
+    const std::string header = dir + "simplenn_" + tag + ".h", driver = dir + "simplenn_" + tag + ".cpp", binary = dir + "simplenn_" + tag;
+    {
+        std::ofstream os(header);
+        supervisor::exportHeader(nn, os, options);
+    }
+
+    random::xoshiro256 gen(21);
+    std::vector<math::vector<double>> xx(20, math::vector<double>(nn.ninputs));
+    {
+        std::ofstream os(driver);
+        os << std::hexfloat << "#include <cstdio>\n#include \"" << header << "\"\n"
+           << "int main() {\n    double xx[" << nn.ninputs << "], yy[" << nn.noutputs << "];\n";
+        for (auto& x : xx) {
+            for (size_t i = 0; i < nn.ninputs; ++i) {
+                x[i] = gen.uniform(-2, 2);
+                os << "    xx[" << i << "] = " << x[i] << ";\n";
+            }
+            os << "    " << options.name << "::calculate(xx, yy);\n"
+               << "    for (int i = 0; i < " << nn.noutputs << "; ++i) std::printf(\"%a\\n\", yy[i]);\n";
+        }
+        // NaN passes through the tabulated and the exact sigmoid and tanh (relu maps it to 0)
+        os << "    std::printf(\"%d\\n\", std::isnan(" << options.name << "::innerTransfer(NAN)) ? 1 : 0);\n";
+        os << "}\n";
+    }
+
+    // no include paths: the generated code must not depend on Eigen or eigen-stl-interface
+    const char* cxx = std::getenv("CXX");
+    const std::string command = std::string(cxx ? cxx : "c++") + " -std=c++17 -O1 -o " + binary + " " + driver;
+    ASSERT_EQ(0, std::system(command.c_str())) << command;
+
+    FILE* pipe = popen(binary.c_str(), "r");
+    ASSERT_NE(nullptr, pipe);
+    char line[128];
+    for (const auto& x : xx) {
+        supervisor::calculateNN(x, nn);
+        for (size_t i = 0; i < nn.noutputs; ++i) {
+            ASSERT_NE(nullptr, fgets(line, sizeof(line), pipe));
+            EXPECT_NEAR(nn.ooutput[i], std::strtod(line, nullptr), 1e-12);
+        }
+    }
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), pipe));
+#ifndef RELU
+    EXPECT_EQ(1, std::atoi(line));
+#endif
+    pclose(pipe);
+}
+
+TEST(NNTest, GeneratedHeaderMatchesCalculateNN) {
+    nn nn1(4, 3, 50);
+    supervisor::init(nn1);
+    codegenOptions unrolled;
+    unrolled.name = "unrolled";
+    checkGeneratedHeader(nn1, unrolled, "unrolled");
+
+    config c;
+    c.approx.apply = true;
+    nn nn2(32, 4, 200, c);
+    supervisor::init(nn2);
+    codegenOptions loops;
+    loops.name = "loops";
+    loops.unrollLimit = 1000;
+    checkGeneratedHeader(nn2, loops, "loops");
+}
+
+// run the workers of a distributed training as child processes, one shard each
+static std::vector<pid_t> spawnWorkers(const endpoint& address, const std::vector<dataSet>& dataset, size_t nworkers) {
+    std::vector<pid_t> pids;
+    for (size_t k = 0; k < nworkers; ++k) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            nn worker(4, 3, 20);
+            const bool ok = parameterServer::work(address, worker, parameterServer::shard(dataset, k, nworkers));
+            _exit(ok ? 0 : 1);
+        }
+        pids.push_back(pid);
+    }
+    return pids;
+}
+
+static bool joinWorkers(const std::vector<pid_t>& pids) {
+    bool ok = true;
+    for (pid_t pid : pids) {
+        int status = 0;
+        ok = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+    }
+    return ok;
+}
+
+TEST(NNTest, HalfPrecisionConversion) {
+    EXPECT_EQ(1.0f, parameterServer::fromHalf(parameterServer::toHalf(1.0f)));
+    EXPECT_EQ(-65504.0f, parameterServer::fromHalf(parameterServer::toHalf(-65504.0f)));
+    EXPECT_EQ(std::ldexp(1.0f, -24), parameterServer::fromHalf(parameterServer::toHalf(std::ldexp(1.0f, -24))));
+    EXPECT_EQ(0.0f, parameterServer::fromHalf(parameterServer::toHalf(std::ldexp(1.0f, -26))));
+    EXPECT_TRUE(std::isinf(parameterServer::fromHalf(parameterServer::toHalf(1e6f))));
+    // ties round to even
+    EXPECT_EQ(0x3c00, parameterServer::toHalf(1.0f + std::ldexp(1.0f, -11)));
+    EXPECT_EQ(0x3c02, parameterServer::toHalf(1.0f + 3 * std::ldexp(1.0f, -11)));
+
+    random::xoshiro256 gen(3);
+    for (int i = 0; i < 10000; ++i) {
+        const float x = (float)gen.uniform(-1, 1);
+        EXPECT_LE(std::abs(parameterServer::fromHalf(parameterServer::toHalf(x)) - x), std::ldexp(std::abs(x), -11) + std::ldexp(1.0f, -25));
+    }
+}
+
+TEST(NNTest, DistributedTrainingMatchesSerial) {
+    const auto dataset = xorLikeDataset();
+    const size_t nsteps = 50;
+    distributedOptions options;
+    options.nworkers = 3;
+    options.maxSteps = nsteps;
+
+    nn serial(4, 3, 20);
+    supervisor::init(serial);
+    workspace ws = supervisor::createWorkspace(serial);
+    const math::vector<double> mask(serial.ntotparameters, 1);
+    for (size_t s = 0; s < nsteps; ++s)
+        supervisor::step(serial, dataset, 1, mask, ws);
+
+    // unix socket, full precision: the summed gradients only differ by rounding
+    nn distributed(4, 3, 20);
+    supervisor::init(distributed);
+    {
+        endpoint address;
+        address.path = testing::TempDir() + "simplenn_ps.sock";
+        parameterServer server(address);
+        ASSERT_TRUE(server.valid());
+        auto pids = spawnWorkers(address, dataset, options.nworkers);
+        EXPECT_TRUE(server.train(distributed, 0, 1, options));
+        EXPECT_TRUE(joinWorkers(pids));
+    }
+    for (size_t i = 0; i < serial.ntotparameters; ++i)
+        EXPECT_NEAR(serial.parameters[i], distributed.parameters[i], 1e-10);
+
+    // tcp, half precision gradients
+    nn compressed(4, 3, 20);
+    supervisor::init(compressed);
+    options.compress = true;
+    {
+        // port 0: the system chooses a free port
+        endpoint address;
+        parameterServer server(address);
+        ASSERT_TRUE(server.valid());
+        address.port = server.port();
+        auto pids = spawnWorkers(address, dataset, options.nworkers);
+        EXPECT_TRUE(server.train(compressed, 0, 1, options));
+        EXPECT_TRUE(joinWorkers(pids));
+    }
+    const double lserial = supervisor::loss(serial, dataset, ws);
+    const double lcompressed = supervisor::loss(compressed, dataset, ws);
+    std::cout << "loss serial: " << lserial << ", fp16 gradients: " << lcompressed << std::endl;
+    EXPECT_NEAR(lserial, lcompressed, 1e-2 * lserial);
+}
+
+// network whose parameters all equal value
+static std::unique_ptr<const nn> constantNetwork(double value) {
+    std::unique_ptr<nn> model(new nn(4, 3, 20));
+    std::fill(model->parameters.data(), model->parameters.data() + model->ntotparameters, value);
+    return std::unique_ptr<const nn>(std::move(model));
+}
+
+TEST(NNTest, HotSwapUnderConcurrentInference) {
+    modelHandle handle(constantNetwork(1));
+    const size_t nreaders = 4, nversions = 500;
+    std::atomic<bool> done(false);
+    std::atomic<size_t> torn(0), reads(0);
+
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < nreaders; ++r)
+        readers.emplace_back([&] {
+            modelHandle::reader reader(handle);
+            workspace ws = supervisor::createWorkspace(reader.read().model());
+            math::vector<double> xx(4, 0.5);
+            uint64_t last = 0;
+            while (!done.load()) {
+                modelHandle::snapshot snap = reader.read();
+                const nn& model = snap.model();
+                // version numbers never go back and every snapshot is one consistent model
+                if (snap.number() < last || model.parameters[0] != (double)snap.number() || model.parameters[model.ntotparameters - 1] != (double)snap.number())
+                    ++torn;
+                last = snap.number();
+                supervisor::calculateNN(xx, model, ws);
+                ++reads;
+            }
+        });
+
+    for (size_t v = 2; v <= nversions; ++v) {
+        // let the readers make progress between the swaps
+        while (reads.load() < v * nreaders)
+            std::this_thread::yield();
+        EXPECT_EQ(v, handle.publish(constantNetwork((double)v)));
+    }
+    done = true;
+    for (auto& t : readers)
+        t.join();
+    EXPECT_EQ(0u, torn.load());
+    EXPECT_EQ(0u, handle.reclaim());
+    std::cout << "reads during " << nversions << " swaps: " << reads.load() << std::endl;
+
+    // a held snapshot stays valid across publishes
+    modelHandle::reader reader(handle);
+    {
+        modelHandle::snapshot snap = reader.read();
+        handle.publish(constantNetwork(0));
+        EXPECT_EQ(1u, handle.reclaim());
+        EXPECT_EQ((double)nversions, snap.model().parameters[0]);
+    }
+    EXPECT_EQ(0u, handle.reclaim());
+    EXPECT_EQ(nversions + 1, reader.read().number());
+}
+
+TEST(NNTest, KernelVariantsAgree) {
+    EXPECT_EQ(cpu::avx2, cpu::parse("avx2", cpu::generic));
+    EXPECT_EQ(cpu::generic, cpu::parse(nullptr, cpu::generic));
+    EXPECT_EQ(cpu::avx512, cpu::parse("sse", cpu::avx512));
+    EXPECT_LE(cpu::selected(), cpu::detect());
+    std::cout << "detected: " << cpu::name(cpu::detect()) << ", selected: " << cpu::name(cpu::selected()) << std::endl;
+
+    random::xoshiro256 gen(11);
+    const transferTable table = transferTable::sigmoid(1e-4);
+    const kernelTable& reference = cpu::kernels(cpu::generic);
+    for (int i = cpu::generic; i <= cpu::detect(); ++i) {
+        const kernelTable& k = cpu::kernels((cpu::isa)i);
+        EXPECT_STREQ(cpu::name((cpu::isa)i), k.name);
+        // sizes with and without remainders of the vector width
+        for (size_t rows : { 1, 3, 17, 64 })
+            for (size_t cols : { 1, 4, 7, 33, 200 }) {
+                std::vector<double> A(rows * cols), x(cols), y(rows), v(rows), w(cols);
+                for (auto& a : A) a = gen.uniform(-1, 1);
+                for (auto& a : x) a = gen.uniform(-1, 1);
+                for (auto& a : v) a = gen.uniform(-1, 1);
+
+                std::vector<double> y1(rows), y2(rows), w1(cols), w2(cols), A1(A), A2(A);
+                reference.gemv(A.data(), x.data(), y1.data(), rows, cols);
+                k.gemv(A.data(), x.data(), y2.data(), rows, cols);
+                reference.gemvT(A.data(), v.data(), w1.data(), rows, cols);
+                k.gemvT(A.data(), v.data(), w2.data(), rows, cols);
+                reference.ger(A1.data(), v.data(), x.data(), rows, cols);
+                k.ger(A2.data(), v.data(), x.data(), rows, cols);
+                for (size_t r = 0; r < rows; ++r)
+                    EXPECT_NEAR(y1[r], y2[r], 1e-12);
+                for (size_t c = 0; c < cols; ++c)
+                    EXPECT_NEAR(w1[c], w2[c], 1e-12);
+                for (size_t j = 0; j < A.size(); ++j)
+                    EXPECT_NEAR(A1[j], A2[j], 1e-12);
+                EXPECT_NEAR(reference.squaredDistance(A.data(), A1.data(), A.size()), k.squaredDistance(A.data(), A1.data(), A.size()), 1e-10);
+
+                std::vector<double> mask(A.size(), 1), p1(A), p2(A);
+                mask[0] = 0;
+                reference.update(p1.data(), 0.3, mask.data(), A1.data(), A.size());
+                k.update(p2.data(), 0.3, mask.data(), A1.data(), A.size());
+                for (size_t j = 0; j < A.size(); ++j)
+                    EXPECT_NEAR(p1[j], p2[j], 1e-12);
+
+                std::vector<double> t1(A.size()), t2(A.size());
+                for (size_t j = 0; j < A.size(); ++j)
+                    t1[j] = t2[j] = gen.uniform(-15, 15);
+                reference.interpolate(table, t1.data(), t1.size());
+                k.interpolate(table, t2.data(), t2.size());
+                for (size_t j = 0; j < A.size(); ++j)
+                    EXPECT_NEAR(t1[j], t2[j], 1e-12);
+            }
+
+        // timing of the hidden layer of a large network
+        const size_t rows = 512, cols = 512, nrepeat = 200;
+        std::vector<double> A(rows * cols, 0.5), x(cols, 0.25), y(rows);
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (size_t r = 0; r < nrepeat; ++r)
+            k.gemv(A.data(), x.data(), y.data(), rows, cols);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        std::cout << k.name << " gemv 512x512: " << std::chrono::duration<double, std::milli>(t1 - t0).count() / nrepeat << " ms" << std::endl;
+    }
+}
+
+TEST(NNTest, ResourceAccounting) {
+    nn nn(4, 3, 50);
+    supervisor::init(nn);
+    const auto dataset = xorLikeDataset();
+    const resourceReport r = supervisor::resources(nn, dataset);
+    r.print(std::cout);
+
+    EXPECT_EQ(nn.ntotparameters * sizeof(double), r.parameterBytes);
+    EXPECT_EQ((4 + 50 + 3) * sizeof(double), r.activationBytes);
+    EXPECT_EQ(supervisor::createWorkspace(nn).arena.size() * sizeof(double), r.workspaceBytes);
+    EXPECT_EQ(dataset.capacity() * sizeof(dataSet) + 4 * 7 * sizeof(double), r.datasetBytes);
+    // 2 flops per weight, one per threshold
+    EXPECT_EQ(2 * (4 + 50 * 4 + 3 * 50) + 4 + 50 + 3, r.forwardFlops);
+    EXPECT_GT(r.backwardFlops, 2 * r.forwardFlops - 2 * 4 * 50);
+
+    // the training loop only allocates the workspace and the mask (a math::vector, allocated by
+    // Eigen with malloc); malloc rounds each block up by less than 32 B
+    ASSERT_TRUE(heapTracker::enabled());
+    const size_t peak = heapTracker::measure([&] { supervisor::train(nn, dataset, 0.1, 15); });
+    std::cout << "peak heap during training: " << peak << " B" << std::endl;
+    EXPECT_GE(peak, r.workspaceBytes + nn.ntotparameters * sizeof(double));
+    EXPECT_LE(peak, r.workspaceBytes + r.optimizerBytes + 64);
+}
+
+TEST(NNTest, FrozenLayersUseCachedActivations) {
+    const size_t ninputs = 16, noutputs = 4, nneurons = 256, nsamples = 64, nsteps = 20;
+    config c;
+    c.freeze.input = c.freeze.hidden = true;
+    nn cached(ninputs, noutputs, nneurons, c), full(ninputs, noutputs, nneurons, c);
+    supervisor::init(cached);
+    supervisor::init(full);
+    const math::vector<double> initial = full.parameters;
+
+    random::xoshiro256 gen(5);
+    std::vector<dataSet> dataset(nsamples, dataSet(ninputs, noutputs));
+    for (auto& d : dataset) {
+        for (size_t i = 0; i < ninputs; ++i)
+            d.xx[i] = gen.uniform(0, 1);
+        for (size_t i = 0; i < noutputs; ++i)
+            d.yy[i] = gen.uniform(0, 1);
+    }
+    const math::vector<double> mask(full.ntotparameters, 1);
+
+    auto t_start = std::chrono::high_resolution_clock::now();
+    frozenCache cache = supervisor::cacheFrozen(cached, dataset);
+    for (size_t s = 0; s < nsteps; ++s)
+        supervisor::step(cached, cache, 1, mask);
+    auto t_mid = std::chrono::high_resolution_clock::now();
+    workspace ws = supervisor::createWorkspace(full);
+    for (size_t s = 0; s < nsteps; ++s)
+        supervisor::step(full, dataset, 1, mask, ws);
+    auto t_end = std::chrono::high_resolution_clock::now();
+    std::cout << "output layer fine-tuning, " << nsteps << " steps: cached " << std::chrono::duration<double, std::milli>(t_mid - t_start).count()
+              << "ms, full network " << std::chrono::duration<double, std::milli>(t_end - t_mid).count() << "ms" << std::endl;
+
+    // the leading layers stay the same, the output layer matches the full computation
+    const size_t frozen = full.layout.oweights;
+    for (size_t i = 0; i < frozen; ++i) {
+        EXPECT_EQ(initial[i], full.parameters[i]);
+        EXPECT_EQ(initial[i], cached.parameters[i]);
+    }
+    for (size_t i = frozen; i < full.ntotparameters; ++i) {
+        EXPECT_NEAR(full.parameters[i], cached.parameters[i], 1e-10);
+    }
+    EXPECT_NE(initial[full.layout.otheta], cached.parameters[full.layout.otheta]);
+}
+
+TEST(NNTest, PrioritizedSamplingNeedsFewerEvaluations) {
+    // skewed dataset: one pattern makes up most of the samples, the rare ones are the hard part
+    const auto patterns = xorLikeDataset();
+    const size_t counts[4] = { 20, 4, 4, 4 };
+    std::vector<dataSet> dataset;
+    for (size_t s = 0; s < 4; ++s)
+        for (size_t k = 0; k < counts[s]; ++k)
+            dataset.push_back(patterns[s]);
+    const double accuracy = 0.2, learningrate = 15.0 / dataset.size();
+
+    config c;
+    c.sample.apply = true;
+    c.sample.batch = 4;
+    c.sample.solved = accuracy / (2 * dataset.size());
+    nn sampled(4, 3, 16, c);
+    supervisor::init(sampled);
+    const math::vector<double> mask(sampled.ntotparameters, 1);
+    const samplingReport report = supervisor::trainSampled(sampled, dataset, accuracy, learningrate, mask);
+    const size_t nsampled = report.forwards + report.backwards;
+    workspace ws = supervisor::createWorkspace(sampled);
+    EXPECT_LE(report.loss, accuracy);
+    EXPECT_LE(supervisor::loss(sampled, dataset, ws), accuracy);
+
+    // full gradient descent from the same start does not reach the accuracy with as many evaluations
+    nn full(4, 3, 16);
+    supervisor::init(full);
+    double lf = 0;
+    size_t nfull = 0;
+    for (; nfull < nsampled; nfull += dataset.size())
+        lf = supervisor::step(full, dataset, learningrate, mask, ws);
+    std::cout << "evaluations: prioritized " << nsampled << " (" << report.steps << " steps) to reach "
+              << accuracy << ", full batch " << nfull << " to reach " << lf << std::endl;
+    EXPECT_GT(lf, accuracy);
+}
+
+TEST(NNTest, SampledTrainingContinuesWhenAllSamplesAreSolved) {
+    // every sample counts as solved (a loss is at most sqrt(3) / 2), their sum is still above accuracy
+    const auto dataset = xorLikeDataset();
+    const double accuracy = 0.2;
+    config c;
+    c.sample.apply = true;
+    c.sample.batch = 2;
+    c.sample.solved = 1;
+    nn nn(4, 3, 16, c);
+    supervisor::init(nn);
+    const math::vector<double> mask(nn.ntotparameters, 1);
+    const samplingReport report = supervisor::trainSampled(nn, dataset, accuracy, 4, mask);
+    workspace ws = supervisor::createWorkspace(nn);
+    EXPECT_GT(report.steps, 0u);
+    EXPECT_LE(report.loss, accuracy);
+    EXPECT_LE(supervisor::loss(nn, dataset, ws), accuracy);
+}
+
+TEST(NNTest, EvaluationIsDeterministic) {
+    const size_t ninputs = 8, noutputs = 3, nneurons = 16, nsamples = 5000;
+    nn nn(ninputs, noutputs, nneurons);
+    supervisor::init(nn);
+    random::xoshiro256 gen(6);
+    std::vector<dataSet> dataset(nsamples, dataSet(ninputs, noutputs));
+    for (auto& d : dataset) {
+        for (size_t i = 0; i < ninputs; ++i)
+            d.xx[i] = gen.uniform(0, 1);
+        for (size_t i = 0; i < noutputs; ++i)
+            d.yy[i] = gen.uniform(0, 1);
+    }
+
+    // the activations of the network stay as they were
+    supervisor::calculateNN(dataset[0].xx, nn);
+    const math::vector<double> ooutput = nn.ooutput;
+
+    threadPool serial(1);
+    const evaluation reference = supervisor::evaluate(nn, dataset, serial);
+    for (size_t nthreads : { 2, 3, 8 }) {
+        threadPool pool(nthreads);
+        const evaluation e = supervisor::evaluate(nn, dataset, pool);
+        EXPECT_EQ(0, std::memcmp(&reference.loss, &e.loss, sizeof(double)));
+        EXPECT_EQ(0, std::memcmp(&reference.mse, &e.mse, sizeof(double)));
+        EXPECT_EQ(reference.accuracy, e.accuracy);
+        EXPECT_EQ(0, std::memcmp(reference.outputError.data(), e.outputError.data(), noutputs * sizeof(double)));
+    }
+    for (size_t j = 0; j < noutputs; ++j)
+        EXPECT_EQ(ooutput[j], nn.ooutput[j]);
+
+    // same metrics computed serially
+    workspace ws = supervisor::createWorkspace(nn);
+    double squared = 0;
+    size_t correct = 0;
+    std::vector<double> absolute(noutputs, 0);
+    for (const auto& d : dataset) {
+        supervisor::calculateNN(d.xx, nn, ws);
+        for (size_t j = 0; j < noutputs; ++j) {
+            squared += std::pow(ws.ooutput[j] - d.yy[j], 2);
+            absolute[j] += std::fabs(ws.ooutput[j] - d.yy[j]);
+        }
+        correct += std::max_element(ws.ooutput, ws.ooutput + noutputs) - ws.ooutput == std::max_element(d.yy.data(), d.yy.data() + noutputs) - d.yy.data();
+    }
+    EXPECT_EQ(nsamples, reference.nsamples);
+    EXPECT_NEAR(supervisor::loss(nn, dataset, ws), reference.loss, 1e-9);
+    EXPECT_NEAR(squared / (nsamples * noutputs), reference.mse, 1e-12);
+    EXPECT_EQ((double)correct / nsamples, reference.accuracy);
+    for (size_t j = 0; j < noutputs; ++j)
+        EXPECT_NEAR(absolute[j] / nsamples, reference.outputError[j], 1e-12);
+}
+
+TEST(NNTest, ValidationRunsConcurrently) {
+    auto dataset = xorLikeDataset();
+    std::atomic<size_t> nreports(0);
+    validationOptions options;
+    options.every = 5;
+    options.report = [&](size_t, const evaluation&) { ++nreports; };
+
+    nn nn(4, 3, 8);
+    supervisor::init(nn);
+    const math::vector<double> mask(nn.ntotparameters, 1);
+    validator v(nn, dataset, options);
+    const size_t steps = v.train(nn, dataset, 0.1, 15, mask);
+    v.wait();
+
+    // every submitted snapshot was either validated or replaced by a newer one
+    const auto history = v.history();
+    EXPECT_EQ((steps + options.every - 1) / options.every, history.size() + v.skipped());
+    EXPECT_EQ(history.size(), nreports.load());
+    for (size_t i = 0; i < history.size(); ++i) {
+        EXPECT_EQ(0u, history[i].step % options.every);
+        if (i > 0) {
+            EXPECT_LT(history[i - 1].step, history[i].step);
+        }
+    }
+    EXPECT_FALSE(v.shouldStop());
+    workspace ws = supervisor::createWorkspace(nn);
+    EXPECT_LE(supervisor::loss(nn, dataset, ws), 0.1);
+
+    // keep training until the validation thread has reported a snapshot, so the report has to
+    // arrive while the training thread is still stepping
+    std::atomic<size_t> nconcurrent(0);
+    validationOptions concurrent;
+    concurrent.every = 1;
+    concurrent.report = [&](size_t, const evaluation&) { ++nconcurrent; };
+    supervisor::init(nn);
+    validator w(nn, dataset, concurrent);
+    const size_t maxsteps = 1000000;
+    size_t step = 0;
+    for (; step < maxsteps && nconcurrent.load() == 0; ++step) {
+        w.submit(nn, step);
+        supervisor::step(nn, dataset, 1e-3, mask, ws);
+    }
+    ASSERT_LT(step, maxsteps);
+    EXPECT_GE(nconcurrent.load(), 1u);
+    w.wait();
+    EXPECT_EQ(step, w.history().size() + w.skipped());
+}
+
+TEST(NNTest, ValidationStopsEarly) {
+    // the validation targets are the opposite of the training targets, fitting the training set
+    // makes the validation loss worse
+    auto dataset = xorLikeDataset();
+    auto opposite = xorLikeDataset();
+    for (auto& d : opposite)
+        for (size_t j = 0; j < d.yy.size(); ++j)
+            d.yy[j] = 1 - d.yy[j];
+    validationOptions options;
+    options.every = 2;
+    options.patience = 3;
+
+    nn nn(4, 3, 8);
+    supervisor::init(nn);
+    const math::vector<double> mask(nn.ntotparameters, 1);
+    validator v(nn, opposite, options);
+    v.train(nn, dataset, 1e-6, 15, mask);
+
+    EXPECT_TRUE(v.shouldStop());
+    // the restored parameters are those of the best snapshot
+    threadPool serial(1);
+    EXPECT_EQ(v.best(), supervisor::evaluate(nn, opposite, serial).loss);
+    EXPECT_GE(v.history().size(), options.patience + 1);
+}
+
+TEST(NNTest, OnlineLearningFromStream) {
+    nn nn(4, 3, 50);
+    supervisor::init(nn);
+    const auto patterns = xorLikeDataset();
+    workspace ws = supervisor::createWorkspace(nn);
+    const double lf0 = supervisor::loss(nn, patterns, ws);
+
+    onlineOptions options;
+    options.learningrate = 5;
+    options.window = 64;
+    onlineLearner learner(nn, options);
+    random::xoshiro256 gen(7);
+    const size_t nupdates = 20000;
+    learner.learn(patterns[0]);
+
+    // the samples arrive one by one, no update allocates
+    const size_t before = heapTracker::allocations();
+    Eigen::internal::set_is_malloc_allowed(false);
+    auto t_start = std::chrono::high_resolution_clock::now();
+    for (size_t u = 1; u < nupdates; ++u)
+        learner.learn(patterns[gen() % patterns.size()]);
+    auto t_end = std::chrono::high_resolution_clock::now();
+    Eigen::internal::set_is_malloc_allowed(true);
+    EXPECT_EQ(before, heapTracker::allocations());
+    std::cout << "online update 4-50-3, " << options.replay << " replayed samples: "
+              << std::chrono::duration<double, std::micro>(t_end - t_start).count() / (nupdates - 1) << "us" << std::endl;
+
+    EXPECT_EQ(nupdates, learner.updates());
+    EXPECT_EQ(options.window, learner.size());
+    EXPECT_LT(learner.learningRate(), options.learningrate);
+    const double lf = supervisor::loss(nn, patterns, ws);
+    std::cout << "loss before " << lf0 << ", after " << lf << std::endl;
+    EXPECT_LT(lf, 0.1);
+}
+
+TEST(NNTest, CopyMoveAndClone) {
+    nn original(4, 3, 8);
+    supervisor::init(original);
+    const math::vector<double> parameters = original.parameters;
+
+    // the views of a copy point into its own parameters
+    nn copy(original);
+    EXPECT_NE(original.parameters.data(), copy.parameters.data());
+    EXPECT_EQ(copy.parameters.data() + copy.layout.hweights, &copy.hweights(0, 0));
+    EXPECT_EQ(copy.parameters.data() + copy.layout.oweights, &copy.oweights(0, 0));
+    copy.hweights(1, 2) += 1;
+    copy.otheta[0] += 1;
+    for (size_t i = 0; i < original.ntotparameters; ++i)
+        EXPECT_EQ(parameters[i], original.parameters[i]);
+
+    // same outputs as the original until it is modified
+    nn same(original);
+    workspace ws1 = supervisor::createWorkspace(original), ws2 = supervisor::createWorkspace(original);
+    const auto dataset = xorLikeDataset();
+    supervisor::calculateNN(dataset[1].xx, original, ws1);
+    supervisor::calculateNN(dataset[1].xx, same, ws2);
+    for (size_t j = 0; j < 3; ++j)
+        EXPECT_EQ(ws1.ooutput[j], ws2.ooutput[j]);
+
+    // a moved network keeps working, the moved-from one keeps no views into its parameters
+    nn moved(std::move(same));
+    EXPECT_EQ(moved.parameters.data() + moved.layout.hweights, &moved.hweights(0, 0));
+    EXPECT_EQ(0u, same.parameters.size());
+    EXPECT_EQ(nullptr, same.hweights.data());
+    EXPECT_EQ(0, same.hweights.size());
+    EXPECT_EQ(nullptr, same.otheta.data());
+    supervisor::calculateNN(dataset[1].xx, moved, ws2);
+    for (size_t j = 0; j < 3; ++j)
+        EXPECT_EQ(ws1.ooutput[j], ws2.ooutput[j]);
+
+    // clones share the network until one of them writes
+    sharedNN a(original);
+    sharedNN b = a.clone();
+    EXPECT_TRUE(b.shared());
+    EXPECT_EQ(&a.read(), &b.read());
+    b.write().otheta[1] = 42;
+    EXPECT_FALSE(a.shared());
+    EXPECT_NE(&a.read(), &b.read());
+    EXPECT_EQ(parameters[original.layout.otheta + 1], a.read().parameters[original.layout.otheta + 1]);
+    EXPECT_EQ(42, b.read().otheta[1]);
+    EXPECT_EQ(b.read().parameters.data() + b.read().layout.otheta + 1, &b.read().otheta[1]);
+}
+
+TEST(NNTest, SparseInputsMatchDense) {
+    const size_t ninputs = 300, noutputs = 3, nneurons = 16, nsamples = 20;
+    nn nn(ninputs, noutputs, nneurons);
+    supervisor::init(nn);
+    // thresholds that are not zero, so zero inputs still activate the input layer
+    random::xoshiro256 gen(8);
+    for (size_t i = 0; i < ninputs; ++i)
+        nn.itheta[i] = gen.uniform(-0.5, 0.5);
+
+    // one-hot encoded categories plus a few numeric features
+    std::vector<dataSet> dense;
+    std::vector<sparseDataSet> sparse;
+    std::vector<sparseVector> inputs;
+    for (size_t s = 0; s < nsamples; ++s) {
+        dataSet d(ninputs, noutputs);
+        for (size_t i = 0; i < ninputs; ++i)
+            d.xx[i] = 0;
+        d.xx[gen() % 100] = 1;
+        d.xx[100 + gen() % 100] = 1;
+        d.xx[200 + gen() % 100] = gen.uniform(0, 1);
+        for (size_t j = 0; j < noutputs; ++j)
+            d.yy[j] = gen.uniform(0, 1);
+        dense.push_back(d);
+        inputs.push_back(sparseVector(d.xx.data(), ninputs));
+        sparse.push_back(sparseDataSet(inputs.back(), d.yy));
+        EXPECT_EQ(3u, inputs.back().nonzeros());
+    }
+
+    // forward
+    workspace ws = supervisor::createWorkspace(nn), sws = supervisor::createWorkspace(nn);
+    sparseCache cache = supervisor::prepareSparse(nn);
+    std::vector<math::vector<double>> yy;
+    supervisor::calculateNN(csrMatrix(inputs), nn, yy);
+    for (size_t s = 0; s < nsamples; ++s) {
+        supervisor::calculateNN(dense[s].xx, nn, ws);
+        supervisor::calculateNN(sparse[s].xx, nn, sws, cache);
+        for (size_t j = 0; j < noutputs; ++j) {
+            EXPECT_NEAR(ws.ooutput[j], sws.ooutput[j], 1e-12);
+            EXPECT_NEAR(ws.ooutput[j], yy[s][j], 1e-12);
+        }
+    }
+
+    // backward
+    const double lf = supervisor::gradient(nn, dense, ws);
+    EXPECT_NEAR(lf, supervisor::gradient(nn, sparse, sws, cache), 1e-12);
+    for (size_t i = 0; i < nn.ntotparameters; ++i)
+        EXPECT_NEAR(ws.gradient[i], sws.gradient[i], 1e-12);
+
+    // training on the sparse dataset lowers the loss
+    const math::vector<double> mask(nn.ntotparameters, 1);
+    double after = 0;
+    for (int s = 0; s < 50; ++s)
+        after = supervisor::step(nn, sparse, 0.5, mask, sws, cache);
+    EXPECT_LT(after, lf);
+}
+
+TEST(NNTest, WideSparseInputs) {
+    const size_t ninputs = 20000, noutputs = 3, nneurons = 32, nsamples = 64;
+    nn nn(ninputs, noutputs, nneurons);
+    supervisor::init(nn);
+    random::xoshiro256 gen(9);
+    std::vector<dataSet> dense(nsamples, dataSet(ninputs, noutputs));
+    std::vector<sparseDataSet> sparse;
+    for (auto& d : dense) {
+        for (size_t i = 0; i < ninputs; ++i)
+            d.xx[i] = 0;
+        for (int f = 0; f < 10; ++f)
+            d.xx[f * 2000 + gen() % 2000] = 1;
+        for (size_t j = 0; j < noutputs; ++j)
+            d.yy[j] = gen.uniform(0, 1);
+        sparse.push_back(sparseDataSet(sparseVector(d.xx.data(), ninputs), d.yy));
+    }
+
+    workspace ws = supervisor::createWorkspace(nn), sws = supervisor::createWorkspace(nn);
+    sparseCache cache(ninputs, nneurons);
+    auto t_start = std::chrono::high_resolution_clock::now();
+    const double lf = supervisor::gradient(nn, dense, ws);
+    auto t_mid = std::chrono::high_resolution_clock::now();
+    const double slf = supervisor::gradient(nn, sparse, sws, cache);
+    auto t_end = std::chrono::high_resolution_clock::now();
+    std::cout << "gradient " << ninputs << "x" << nneurons << "x" << noutputs << ", " << nsamples << " samples with 10 nonzero inputs: dense "
+              << std::chrono::duration<double, std::milli>(t_mid - t_start).count() << "ms, sparse "
+              << std::chrono::duration<double, std::milli>(t_end - t_mid).count() << "ms" << std::endl;
+    EXPECT_NEAR(lf, slf, 1e-9);
+    for (size_t i = 0; i < nn.ntotparameters; ++i)
+        EXPECT_NEAR(ws.gradient[i], sws.gradient[i], 1e-12);
+}
+
+TEST(NNTest, InferenceCacheEvictsLeastRecentlyUsed) {
+    inferenceCache cache(2, 1);
+    math::vector<double> a(2, 0), b(2, 1), c(2, 2), y(1, 0), out(1, 0);
+    y[0] = 1;
+    cache.insert(a, 1, y);
+    y[0] = 2;
+    cache.insert(b, 1, y);
+    EXPECT_TRUE(cache.lookup(a, 1, out));
+    EXPECT_EQ(1, out[0]);
+    y[0] = 3;
+    cache.insert(c, 1, y);
+    // b was used least recently
+    EXPECT_FALSE(cache.lookup(b, 1, out));
+    EXPECT_TRUE(cache.lookup(c, 1, out));
+    EXPECT_EQ(3, out[0]);
+    // a newer model version does not see the entry and drops it
+    EXPECT_FALSE(cache.lookup(a, 2, out));
+    EXPECT_FALSE(cache.lookup(a, 1, out));
+    // an older one misses the entry of the newer version but neither drops nor overwrites it
+    y[0] = 4;
+    cache.insert(a, 2, y);
+    EXPECT_FALSE(cache.lookup(a, 1, out));
+    y[0] = 5;
+    cache.insert(a, 1, y);
+    EXPECT_TRUE(cache.lookup(a, 2, out));
+    EXPECT_EQ(4, out[0]);
+
+    const cacheStats stats = cache.stats();
+    EXPECT_EQ(3u, stats.hits);
+    EXPECT_EQ(4u, stats.misses);
+    EXPECT_EQ(1u, stats.evictions);
+    EXPECT_EQ(1u, stats.invalidations);
+    EXPECT_EQ(2u, cache.size());
+
+    // once full, evicting, dropping and reusing entries does not allocate
+    const size_t before = heapTracker::allocations();
+    for (int i = 0; i < 100; ++i) {
+        a[0] = b[0] = c[0] = i;
+        cache.insert(a, 1, y);
+        cache.insert(b, 1, y);
+        cache.lookup(b, 2, out);
+        cache.insert(c, 1, y);
+        cache.lookup(c, 1, out);
+    }
+    EXPECT_EQ(before, heapTracker::allocations());
+
+    // the output is resized to the cached one
+    math::vector<double> empty;
+    EXPECT_TRUE(cache.lookup(c, 1, empty));
+    ASSERT_EQ(1u, empty.size());
+    EXPECT_EQ(y[0], empty[0]);
+}
+
+TEST(NNTest, InferenceCacheUnderConcurrentInference) {
+    std::unique_ptr<nn> first(new nn(4, 3, 20));
+    supervisor::init(*first);
+    modelHandle handle(std::move(first));
+    inferenceCache cache(64);
+
+    // binary inputs as in main.cpp, 16 distinct vectors
+    std::vector<math::vector<double>> inputs;
+    for (int k = 0; k < 16; ++k) {
+        math::vector<double> xx(4);
+        for (int i = 0; i < 4; ++i)
+            xx[i] = (k >> i) & 1;
+        inputs.push_back(xx);
+    }
+
+    const size_t nthreads = 4, nrequests = 2000;
+    std::atomic<size_t> wrong(0);
+    auto serve = [&](size_t t) {
+        modelHandle::reader reader(handle);
+        workspace ws = supervisor::createWorkspace(reader.read().model()), check = supervisor::createWorkspace(reader.read().model());
+        math::vector<double> yy(3);
+        random::xoshiro256 gen(10, t);
+        for (size_t r = 0; r < nrequests; ++r) {
+            const math::vector<double>& xx = inputs[gen() % inputs.size()];
+            cache.calculateNN(xx, reader, ws, yy);
+            supervisor::calculateNN(xx, reader.read().model(), check);
+            for (size_t j = 0; j < 3; ++j)
+                wrong += check.ooutput[j] != yy[j];
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nthreads; ++t)
+        threads.emplace_back(serve, t);
+    for (auto& t : threads)
+        t.join();
+    EXPECT_EQ(0u, wrong.load());
+
+    cacheStats stats = cache.stats();
+    std::cout << "inference cache: " << stats.hits << " hits, " << stats.misses << " misses, hit rate " << stats.hitRate() << std::endl;
+    EXPECT_EQ(nthreads * nrequests, stats.hits + stats.misses);
+    EXPECT_GE(stats.misses, inputs.size());
+    EXPECT_GT(stats.hitRate(), 0.9);
+
+    // a new model invalidates the cached outputs
+    std::unique_ptr<nn> second(new nn(4, 3, 20));
+    supervisor::init(*second, 77);
+    const nn& model = *second;
+    handle.publish(std::move(second));
+    modelHandle::reader reader(handle);
+    workspace ws = supervisor::createWorkspace(model), check = supervisor::createWorkspace(model);
+    math::vector<double> yy(3);
+    cache.calculateNN(inputs[3], reader, ws, yy);
+    supervisor::calculateNN(inputs[3], model, check);
+    for (size_t j = 0; j < 3; ++j)
+        EXPECT_EQ(check.ooutput[j], yy[j]);
+    EXPECT_EQ(stats.invalidations + 1, cache.stats().invalidations);
+}
+
+TEST(NNTest, ModelFileRoundTrip) {
+    nn original(4, 3, 20);
+    supervisor::init(original);
+    std::stringstream ss;
+    EXPECT_TRUE(modelFile::save(original, ss));
+
+    std::unique_ptr<nn> loaded = modelFile::load(ss);
+    ASSERT_TRUE(loaded != nullptr);
+    EXPECT_EQ(original.ninputs, loaded->ninputs);
+    EXPECT_EQ(original.noutputs, loaded->noutputs);
+    EXPECT_EQ(original.nneurons, loaded->nneurons);
+    for (size_t i = 0; i < original.ntotparameters; ++i)
+        EXPECT_EQ(original.parameters[i], loaded->parameters[i]);
+
+    // truncated files are rejected
+    std::string bytes = ss.str();
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 8));
+    EXPECT_TRUE(modelFile::load(truncated) == nullptr);
+    std::stringstream garbage("not a model");
+    EXPECT_TRUE(modelFile::load(garbage) == nullptr);
+
+    // a model of another transfer function is rejected
+    std::string other = bytes;
+    other[4] = modelFile::builtTransfer() == modelFile::sigmoid ? modelFile::relu : modelFile::sigmoid;
+    std::stringstream otherTransfer(other);
+    EXPECT_TRUE(modelFile::load(otherTransfer) == nullptr);
+
+    // sizes beyond the limits are rejected before anything is allocated: too many neurons,
+    // an overflowing size, and sizes within the limits whose product is too large
+    const uint64_t sizes[3][2] = { { 4, modelFile::maxDimension + 1 }, { 4, ~uint64_t(0) },
+        { modelFile::maxDimension, modelFile::maxDimension } };
+    for (const auto& size : sizes) {
+        std::string huge = bytes;
+        std::memcpy(&huge[5], &size[0], sizeof(uint64_t));
+        std::memcpy(&huge[5 + 2 * sizeof(uint64_t)], &size[1], sizeof(uint64_t));
+        std::stringstream hugeModel(huge);
+        EXPECT_TRUE(modelFile::load(hugeModel) == nullptr);
+    }
+
+    // an error bound of the transfer tables that is not finite or too small to build a table for
+    const size_t errorOffset = 5 + 3 * sizeof(uint64_t) + 1;
+    for (double maxError : { 0.0, -1e-4, (double)NAN, (double)INFINITY, 1e-300 }) {
+        std::string bad = bytes;
+        bad[errorOffset - 1] = 1;
+        std::memcpy(&bad[errorOffset], &maxError, sizeof(maxError));
+        std::stringstream badModel(bad);
+        EXPECT_TRUE(modelFile::load(badModel) == nullptr);
+    }
+}
+
+TEST(NNTest, BatchPredictionKeepsOrder) {
+    nn nn(4, 3, 20);
+    supervisor::init(nn);
+    random::xoshiro256 gen(11);
+    const size_t nrows = 1000;
+    std::vector<math::vector<double>> inputs(nrows, math::vector<double>(4));
+    std::stringstream csv, binary;
+    csv.precision(17);
+    for (auto& xx : inputs) {
+        for (size_t i = 0; i < 4; ++i)
+            xx[i] = gen.uniform(0, 1);
+        csv << xx[0] << "," << xx[1] << ", " << xx[2] << " " << xx[3] << "\n";
+        binary.write(reinterpret_cast<const char*>(xx.data()), 4 * sizeof(double));
+    }
+
+    workspace ws = supervisor::createWorkspace(nn);
+    for (size_t nthreads : { 1, 4 }) {
+        predictOptions options;
+        options.batch = 64;
+        options.nthreads = nthreads;
+
+        // binary, bit-identical to calculateNN in input order
+        options.form = predictOptions::binary;
+        std::stringstream in(binary.str()), out;
+        predictReport report;
+        EXPECT_TRUE(predictor::run(nn, in, out, options, report));
+        EXPECT_EQ(nrows, report.rows);
+        const std::string bytes = out.str();
+        ASSERT_EQ(nrows * 3 * sizeof(double), bytes.size());
+        for (size_t r = 0; r < nrows; ++r) {
+            supervisor::calculateNN(inputs[r], nn, ws);
+            EXPECT_EQ(0, std::memcmp(ws.ooutput, bytes.data() + r * 3 * sizeof(double), 3 * sizeof(double)));
+        }
+
+        // csv
+        options.form = predictOptions::csv;
+        std::stringstream csvIn(csv.str()), csvOut;
+        predictReport creport;
+        EXPECT_TRUE(predictor::run(nn, csvIn, csvOut, options, creport));
+        EXPECT_EQ(nrows, creport.rows);
+        std::string line;
+        for (size_t r = 0; r < nrows && std::getline(csvOut, line); ++r) {
+            supervisor::calculateNN(inputs[r], nn, ws);
+            double y[3];
+            ASSERT_EQ(3, std::sscanf(line.c_str(), "%lf,%lf,%lf", &y[0], &y[1], &y[2]));
+            for (size_t j = 0; j < 3; ++j)
+                EXPECT_NEAR(ws.ooutput[j], y[j], 1e-12);
+        }
+    }
+
+    // malformed rows stop the prediction, the rows before are written
+    std::stringstream bad("0,0,0,0\n\n1,1,1,1\n1,1,x,1\n0,0,0,0\n"), out;
+    predictReport report;
+    predictOptions options;
+    EXPECT_FALSE(predictor::run(nn, bad, out, options, report));
+    EXPECT_EQ(2u, report.rows);
+    EXPECT_EQ(4u, report.badRow);
+}
+
+TEST(NNTest, ParameterBlocksAreAligned) {
+    config c;
+    c.init.method = initialization::uniform;
+    c.mem.hugePages = true;
+    nn nn(4, 3, 7, c);
+    supervisor::init(nn);
+
+    // every block starts on a cache line, the padding stays zero through init and training
+    const size_t begin[6] = { nn.layout.iweights, nn.layout.itheta, nn.layout.hweights, nn.layout.htheta, nn.layout.oweights, nn.layout.otheta };
+    for (size_t b = 0; b < 6; ++b)
+        EXPECT_EQ(0u, begin[b] % parameterLayout::line);
+    EXPECT_EQ(0u, nn.ntotparameters % parameterLayout::line);
+    EXPECT_EQ(nn.parameters.data() + nn.layout.htheta, &nn.htheta[0]);
+    EXPECT_EQ(nn.parameters.data() + nn.layout.otheta, &nn.otheta[0]);
+#if EIGEN_MAX_ALIGN_BYTES >= 64
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(nn.parameters.data()) % 64);
+#endif
+
+    const auto dataset = xorLikeDataset();
+    const math::vector<double> mask(nn.ntotparameters, 1);
+    workspace ws = supervisor::createWorkspace(nn);
+    for (size_t s = 0; s < 100; ++s)
+        supervisor::step(nn, dataset, 0.5, mask, ws);
+    size_t npadding = 0;
+    for (size_t i = 0; i < nn.ntotparameters; ++i) {
+        if (nn.layout.padding(i)) {
+            EXPECT_EQ(0, nn.parameters[i]);
+            ++npadding;
+        }
+    }
+    EXPECT_EQ(nn.ntotparameters - (2 * 4 + 7 * 4 + 7 + 3 * 7 + 3), npadding);
+}
+
+TEST(NNTest, HogwildConvergesLikeSynchronousTraining) {
+    // regression onto the outputs of a random teacher network
+    nn teacher(8, 2, 6);
+    supervisor::init(teacher, 7);
+    workspace tws = supervisor::createWorkspace(teacher);
+    random::xoshiro256 gen(11);
+    std::vector<dataSet> dataset;
+    for (size_t s = 0; s < 1024; ++s) {
+        dataSet d(8, 2);
+        for (size_t i = 0; i < 8; ++i)
+            d.xx[i] = gen.uniform();
+        supervisor::calculateNN(d.xx, teacher, tws);
+        for (size_t j = 0; j < 2; ++j)
+            d.yy[j] = tws.ooutput[j];
+        dataset.push_back(d);
+    }
+    nn initial(8, 2, 12);
+    supervisor::init(initial);
+    const math::vector<double> mask(initial.ntotparameters, 1);
+    const double learningrate = 5e-4;
+    const size_t nepochs = 50;
+    hogwildOptions options;
+    options.maxEpochs = nepochs;
+
+    // the baseline is sequential mini-batch SGD: one worker, the same batches and number of updates
+    options.nthreads = 1;
+    nn sequential(initial);
+    const hogwildReport baseline = hogwild::train(sequential, dataset, -1, learningrate, mask, options);
+    const double loss = supervisor::evaluate(sequential, dataset).loss;
+    std::cout << "hogwild, 1 thread: " << baseline.updates << " updates in " << baseline.seconds * 1000 << "ms, loss " << loss << std::endl;
+    EXPECT_EQ(nepochs, baseline.epochs);
+    EXPECT_EQ(nepochs * dataset.size() / options.batch, baseline.updates);
+    EXPECT_LT(loss, supervisor::evaluate(initial, dataset).loss / 2);
+
+    // four workers with as many updates end within 25% of its loss, the races only delay the
+    // training a little
+    options.nthreads = 4;
+    nn async(initial);
+    const hogwildReport report = hogwild::train(async, dataset, -1, learningrate, mask, options);
+    const double asyncLoss = supervisor::evaluate(async, dataset).loss;
+    std::cout << "hogwild, 4 threads: " << report.updates << " updates in " << report.seconds * 1000 << "ms, loss " << asyncLoss
+              << ", speedup " << baseline.seconds / report.seconds << " on " << std::thread::hardware_concurrency() << " cores" << std::endl;
+    EXPECT_EQ(baseline.updates, report.updates);
+    EXPECT_NEAR(loss, asyncLoss, 0.25 * loss);
+    for (size_t i = 0; i < async.ntotparameters; ++i) {
+        if (async.layout.padding(i)) {
+            EXPECT_EQ(0, async.parameters[i]);
+        }
+    }
+
+    // training stops at the first epoch that reaches the accuracy
+    nn stopped(initial);
+    const hogwildReport early = hogwild::train(stopped, dataset, 2 * baseline.loss, learningrate, mask, options);
+    EXPECT_LT(early.epochs, nepochs);
+    EXPECT_LE(early.loss, 2 * baseline.loss);
+
+    // a single worker is deterministic
+    nn a(initial), b(initial);
+    options.nthreads = 1;
+    options.maxEpochs = 10;
+    hogwild::train(a, dataset, -1, learningrate, mask, options);
+    hogwild::train(b, dataset, -1, learningrate, mask, options);
+    EXPECT_EQ(0, std::memcmp(a.parameters.data(), b.parameters.data(), a.ntotparameters * sizeof(double)));
+
+    // a replica refreshed every 4 batches is stale in between but the training still converges
+    options.nthreads = 4;
+    options.maxEpochs = nepochs;
+    options.refresh = 4;
+    nn stale(initial);
+    const hogwildReport staleReport = hogwild::train(stale, dataset, -1, learningrate, mask, options);
+    const double staleLoss = supervisor::evaluate(stale, dataset).loss;
+    std::cout << "hogwild, 4 threads, refresh 4: " << staleReport.seconds * 1000 << "ms, loss " << staleLoss << std::endl;
+    EXPECT_EQ(baseline.updates, staleReport.updates);
+    EXPECT_LT(staleLoss, supervisor::evaluate(initial, dataset).loss / 2);
+    options.refresh = 1;
+
+    // frozen layers are neither read back nor written
+    config c;
+    c.freeze.input = c.freeze.hidden = true;
+    nn frozen(8, 2, 12, c);
+    std::copy(initial.parameters.data(), initial.parameters.data() + initial.ntotparameters, frozen.parameters.data());
+    options.nthreads = 4;
+    hogwild::train(frozen, dataset, -1, learningrate, mask, options);
+    for (size_t i = 0; i < frozen.layout.oweights; ++i) {
+        EXPECT_EQ(initial.parameters[i], frozen.parameters[i]);
+    }
+    EXPECT_NE(initial.parameters[frozen.layout.otheta], frozen.parameters[frozen.layout.otheta]);
+}
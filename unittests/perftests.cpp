@@ -0,0 +1,230 @@
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <memory>
+#include <gtest/gtest.h>
+
+#include "benchmark.h"
+#include "nn.h"
+
+using namespace math;
+
+// keeps the results of the benchmarks alive
+static volatile double sink = 0;
+
+// one harness for all performance tests, the baseline is written at exit if requested. The
+// baseline lies next to this file unless SIMPLENN_BASELINE names another one.
+static benchmark& harness() {
+    const char* path = std::getenv("SIMPLENN_BASELINE");
+    const std::string source = __FILE__;
+    const size_t slash = source.find_last_of("/\\");
+    const std::string dir = slash == std::string::npos ? "." : source.substr(0, slash);
+    static benchmark b(path ? path : dir + "/perf_baseline.json");
+    return b;
+}
+
+// first cache line aligned element of v, which holds 8 doubles more than it is used for. The vector
+// kernels run at a different speed on unaligned data and the heap gives no 64 byte alignment.
+static double* aligned(std::vector<double>& v) {
+    void* p = v.data();
+    size_t space = v.size() * sizeof(double);
+    return static_cast<double*>(std::align(64, sizeof(double), p, space));
+}
+
+// name of a benchmark that runs on the kernels of instruction set i
+static std::string withIsa(const std::string& name, cpu::isa i = cpu::selected()) {
+    return name + " [" + cpu::name(i) + "]";
+}
+
+TEST(PerfTest, DetectsRegression) {
+    auto work = [] {
+        double x = 0;
+        for (int i = 0; i < 20000; ++i)
+            x += std::sqrt((double)i);
+        sink = x;
+    };
+    const std::string path = testing::TempDir() + "simplenn_perf_baseline.json";
+    for (double factor : { 1.0, 0.1 }) {
+        benchmark reference(path + ".unused");
+        const double median = reference.measure("work", work).median;
+        {
+            std::ofstream os(path);
+            os << "{\n    \"calibration\": " << reference.calibrationTime()
+               << ",\n    \"work\": { \"median\": " << factor * median << ", \"low\": 0, \"high\": 0 }\n}\n";
+        }
+        // same speed passes, ten times slower than the baseline fails
+        benchmark b(path);
+        EXPECT_EQ(factor == 1.0, b.run("work", work));
+    }
+}
+
+TEST(PerfTest, MissingBaselineFails) {
+    const char* update = std::getenv("SIMPLENN_UPDATE_BASELINE");
+    if (update && std::string(update) != "0") {
+        GTEST_SKIP() << "missing benchmarks are recorded while the baseline is updated";
+    }
+    benchmark b(testing::TempDir() + "simplenn_perf_baseline.missing.json");
+    EXPECT_FALSE(b.run("work", [] { sink = std::sqrt(2.0); }));
+}
+
+// the math::vector and math::matrix benchmarks measure the eigen-stl-interface submodule, their
+// baseline entries have to be recorded against it (SIMPLENN_UPDATE_BASELINE=1)
+TEST(PerfTest, VectorPushBack) {
+    const int n = 10000;
+    EXPECT_TRUE(harness().run("std::vector push_back", [] {
+        std::vector<double> v;
+        for (int i = 0; i < n; ++i)
+            v.push_back(i);
+        sink = v.back();
+    }));
+    EXPECT_TRUE(harness().run("std::vector push_back reserved", [] {
+        std::vector<double> v;
+        v.reserve(n);
+        for (int i = 0; i < n; ++i)
+            v.push_back(i);
+        sink = v.back();
+    }));
+    EXPECT_TRUE(harness().run("math::vector push_back", [] {
+        math::vector<double> v;
+        for (int i = 0; i < n; ++i)
+            v.push_back(i);
+        sink = v[n - 1];
+    }));
+    EXPECT_TRUE(harness().run("math::vector push_back reserved", [] {
+        math::vector<double> v;
+        v.reserve(n);
+        for (int i = 0; i < n; ++i)
+            v.push_back(i);
+        sink = v[n - 1];
+    }));
+}
+
+TEST(PerfTest, MatrixPushBack) {
+    const int n = 10000;
+    EXPECT_TRUE(harness().run("math::matrix push_back", [] {
+        matrix<double> m;
+        for (int i = 0; i < n; ++i)
+            m.push_back({1, 2, 3});
+        sink = m(n - 1, 2);
+    }));
+    EXPECT_TRUE(harness().run("math::matrix push_back reserved", [] {
+        matrix<double> m;
+        m.reserve_rows(n, 3);
+        for (int i = 0; i < n; ++i)
+            m.push_back({1, 2, 3});
+        sink = m(n - 1, 2);
+    }));
+}
+
+TEST(PerfTest, MatrixMatrixMultiplication) {
+    const size_t nsize = 128;
+    random::xoshiro256 gen(1);
+
+    std::vector<std::vector<double>> cmat1(nsize, std::vector<double>(nsize)), cmat2(nsize, std::vector<double>(nsize));
+    Eigen::MatrixXd emat1(nsize, nsize), emat2(nsize, nsize);
+    matrix<double> dmat1(nsize, nsize), dmat2(nsize, nsize);
+    for (size_t r = 0; r < nsize; ++r)
+        for (size_t c = 0; c < nsize; ++c) {
+            cmat1[r][c] = emat1(r, c) = dmat1(r, c) = gen.uniform(-1, 1);
+            cmat2[r][c] = emat2(r, c) = dmat2(r, c) = gen.uniform(-1, 1);
+        }
+
+    EXPECT_TRUE(harness().run("matmul std::vector 128", [&] {
+        std::vector<std::vector<double>> cmat(nsize, std::vector<double>(nsize));
+        for (size_t r = 0; r < nsize; ++r)
+            for (size_t i = 0; i < nsize; ++i)
+                for (size_t c = 0; c < nsize; ++c)
+                    cmat[r][c] += cmat1[r][i] * cmat2[i][c];
+        sink = cmat[0][0];
+    }));
+    EXPECT_TRUE(harness().run("matmul Eigen 128", [&] {
+        Eigen::MatrixXd emat = emat1 * emat2;
+        sink = emat(0, 0);
+    }));
+    EXPECT_TRUE(harness().run("matmul math::matrix 128", [&] {
+        matrix<double> dmat = dmat1 * dmat2;
+        sink = dmat(0, 0);
+    }));
+}
+
+TEST(PerfTest, NNKernels) {
+    const size_t ninputs = 32, noutputs = 8, nneurons = 256;
+    nn nn(ninputs, noutputs, nneurons);
+    supervisor::init(nn);
+    workspace ws = supervisor::createWorkspace(nn);
+    std::vector<dataSet> dataset(16, dataSet(ninputs, noutputs));
+    random::xoshiro256 gen(2);
+    for (auto& d : dataset) {
+        for (size_t i = 0; i < ninputs; ++i)
+            d.xx[i] = gen.uniform(0, 1);
+        for (size_t i = 0; i < noutputs; ++i)
+            d.yy[i] = gen.uniform(0, 1);
+    }
+
+    EXPECT_TRUE(harness().run(withIsa("nn calculateNN 32x256x8"), [&] {
+        supervisor::calculateNN(dataset[0].xx, nn, ws);
+        sink = ws.ooutput[0];
+    }));
+    EXPECT_TRUE(harness().run(withIsa("nn gradient 32x256x8, 16 samples"), [&] {
+        sink = supervisor::gradient(nn, dataset, ws);
+    }));
+    const math::vector<double> mask(nn.ntotparameters, 1);
+    EXPECT_TRUE(harness().run(withIsa("nn update 32x256x8"), [&] {
+        // zero learning rate, the parameters stay the same for every call
+        supervisor::update(nn, ws.gradient, 0, 0, mask);
+        sink = nn.parameters[0];
+    }));
+
+    // the kernels of every instruction set the CPU supports
+    const size_t rows = 256, cols = 256;
+    const transferTable table = transferTable::sigmoid(1e-4);
+    for (cpu::isa i : { cpu::generic, cpu::avx2, cpu::avx512 }) {
+        if (i > cpu::detect()) {
+            continue;
+        }
+        const kernelTable& k = cpu::kernels(i);
+        std::vector<double> abuffer(rows * cols + 8, 0.5), xbuffer(cols + 8, 0.25), ybuffer(rows + 8);
+        double* A = aligned(abuffer);
+        double* x = aligned(xbuffer);
+        double* y = aligned(ybuffer);
+        EXPECT_TRUE(harness().run(withIsa("kernel gemv 256x256", i), [&] {
+            k.gemv(A, x, y, rows, cols);
+            sink = y[0];
+        }));
+        EXPECT_TRUE(harness().run(withIsa("kernel gemvT 256x256", i), [&] {
+            k.gemvT(A, y, x, rows, cols);
+            sink = x[0];
+        }));
+        EXPECT_TRUE(harness().run(withIsa("kernel interpolate 4096", i), [&] {
+            k.interpolate(table, A, 4096);
+            sink = A[0];
+        }));
+    }
+}
+
+TEST(PerfTest, ApproximateInference) {
+    const size_t ninputs = 32, noutputs = 4, nneurons = 64;
+    config exact, approx;
+    approx.approx.apply = true;
+    approx.approx.maxError = 1e-5;
+    nn nn1(ninputs, noutputs, nneurons, exact), nn2(ninputs, noutputs, nneurons, approx);
+    supervisor::init(nn1);
+    supervisor::init(nn2);
+    workspace ws1 = supervisor::createWorkspace(nn1), ws2 = supervisor::createWorkspace(nn2);
+    random::xoshiro256 gen(11);
+    math::vector<double> xx(ninputs);
+    for (size_t i = 0; i < ninputs; ++i)
+        xx[i] = gen.uniform(-2, 2);
+
+    // the tables pay off only while they are faster than the exact transfer functions
+    EXPECT_TRUE(harness().run(withIsa("nn calculateNN 32x64x4 exact"), [&] {
+        supervisor::calculateNN(xx, nn1, ws1);
+        sink = ws1.ooutput[0];
+    }));
+    EXPECT_TRUE(harness().run(withIsa("nn calculateNN 32x64x4 approximate"), [&] {
+        supervisor::calculateNN(xx, nn2, ws2);
+        sink = ws2.ooutput[0];
+    }));
+}
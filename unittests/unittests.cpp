@@ -188,51 +188,6 @@ TEST(EigenArraysTest, TestVectorReserve) {
         EXPECT_EQ(i - 1, v2[i]);
 }
 
-TEST(EigenArraysTest, TestSTDVectorReserveTiming) {
-    std::cout << "Without reserve():" << std::endl;
-    auto t_start = std::chrono::high_resolution_clock::now();
-    std::vector<double> v1;
-    for (int i = 0; i < 10000; ++i)
-        v1.push_back(i);
-    auto t_end = std::chrono::high_resolution_clock::now();
-    double t1 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "  -> " << t1 << "ms" << std::endl;
-
-    std::cout << "With reserve():" << std::endl;
-    t_start = std::chrono::high_resolution_clock::now();
-    std::vector<double> v2;
-    v2.reserve(10000);
-    for (int i = 0; i < 10000; ++i)
-        v2.push_back(i);
-    t_end = std::chrono::high_resolution_clock::now();
-    double t2 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "  -> " << t2 << "ms" << std::endl;
-    EXPECT_LT(t2, t1);
-}
-
-TEST(EigenArraysTest, TestVectorReserveTiming) {
-    std::cout << "Without reserve():" << std::endl;
-    auto t_start = std::chrono::high_resolution_clock::now();
-    math::vector<double> v1;
-    for (int i = 0; i < 10000; ++i)
-        v1.push_back(i);
-    auto t_end = std::chrono::high_resolution_clock::now();
-    double t1 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "  -> " << t1 << "ms" << std::endl;
-
-    std::cout << "With reserve():" << std::endl;
-    t_start = std::chrono::high_resolution_clock::now();
-    math::vector<double> v2;
-    v2.reserve(10000);
-    for (int i = 0; i < 10000; ++i)
-        v2.push_back(i);
-    t_end = std::chrono::high_resolution_clock::now();
-    double t2 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "  -> " << t2 << "ms" << std::endl;
-    EXPECT_LT(t2, t1);
-}
-
-
 TEST(EigenArraysTest, TestVectorAdvancedDataStructure) {
     //Eigen::matrix<std::map<int, double>, 3, 1> vectmap;
     vector<std::map<int, double>> vectmap;
@@ -608,28 +563,6 @@ TEST(EigenArraysTest, TestMatrixReserve) {
         EXPECT_EQ(i - 1, m1[i][0]);
 }
 
-TEST(EigenArraysTest, TestMatrixReserveTiming) {
-    std::cout << "Without reserve():" << std::endl;
-    auto t_start = std::chrono::high_resolution_clock::now();
-    matrixd m1;
-    for (int i = 0; i < 10000; ++i)
-        m1.push_back({1, 2, 3});
-    auto t_end = std::chrono::high_resolution_clock::now();
-    double t1 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "  -> " << t1 << "ms" << std::endl;
-
-    std::cout << "With reserve():" << std::endl;
-    t_start = std::chrono::high_resolution_clock::now();
-    matrixd m2;
-    m2.reserve_rows(10000, 3);
-    for (int i = 0; i < 10000; ++i)
-        m2.push_back({1, 2, 3});
-    t_end = std::chrono::high_resolution_clock::now();
-    double t2 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "  -> " << t2 << "ms" << std::endl;
-    EXPECT_LT(t2, t1);
-}
-
 TEST(EigenArraysTest, TestMatrixClear) {
     matrixd m1 = { {1,2,3}, {4,5,6} };
     
@@ -776,71 +709,6 @@ TEST(EigenArraysTest, TestMatrixAdvancedDataStructure) {
 
 //#####################################
 
-TEST(EigenArraysTest, TestMatrixmatrixMultiplicationTime) {
-    srand((int)time(NULL));
-
-    const size_t nsize = 128;
-    const size_t nexec = 100;
-
-    std::vector<std::vector<double>> cmat1(nsize, std::vector<double>(nsize)), cmat2(nsize, std::vector<double>(nsize));
-    for (size_t c = 0; c < nsize; ++c)
-        for (size_t r = 0; r < nsize; ++r)
-        {
-            cmat1[r][c] = rand() % 10; // random values
-            cmat2[r][c] = rand() % 10; // to prevent compiler optimization
-        }
-    auto t_start = std::chrono::high_resolution_clock::now();
-    for (size_t e = 0; e < nexec; ++e)
-    {
-        std::vector<std::vector<double>> cmat(nsize, std::vector<double>(nsize));
-        for (size_t c = 0; c < nsize; ++c)
-            for (size_t r = 0; r < nsize; ++r)
-                for (size_t i = 0; i < nsize; ++i)
-                    cmat[r][c] += cmat1[r][c] * cmat2[r][c];
-    }
-    auto t_end = std::chrono::high_resolution_clock::now();
-    double t1 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "std::vector mulitplication took " << t1 / nexec << "ms" << std::endl;
-
-    Eigen::MatrixXd emat1(nsize, nsize), emat2(nsize, nsize);
-    for (size_t c = 0; c < nsize; ++c)
-        for (size_t r = 0; r < nsize; ++r)
-        {
-            emat1(r, c) = rand() % 10;
-            emat2(r, c) = rand() % 10;
-        }
-    t_start = std::chrono::high_resolution_clock::now();
-    for (size_t e = 0; e < nexec; ++e)
-    {
-        Eigen::MatrixXd emat(nsize, nsize);
-        emat = emat1 * emat2;
-    }
-    t_end = std::chrono::high_resolution_clock::now();
-    double t2 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "Eigen mulitplication took " << t2 / nexec << "ms" << std::endl;
-
-    matrix<double> dmat1(nsize, nsize), dmat2(nsize, nsize);
-    for (size_t c = 0; c < nsize; ++c)
-        for (size_t r = 0; r < nsize; ++r)
-        {
-            dmat1(r, c) = rand() % 10;
-            dmat2(r, c) = rand() % 10;
-        }
-    t_start = std::chrono::high_resolution_clock::now();
-    for (size_t e = 0; e < nexec; ++e)
-    {
-        matrix<double> dmat(nsize, nsize);
-        dmat = dmat1 * dmat2;
-    }
-    t_end = std::chrono::high_resolution_clock::now();
-    double t3 = std::chrono::duration<double, std::milli>(t_end - t_start).count();
-    std::cout << "Matrix mulitplication took " << t3 / nexec << "ms" << std::endl;
-
-    // multiplication with Eigen should be faster
-    EXPECT_LT(t3, t1);
-    EXPECT_LT(t2, t1);
-}
-
 TEST(EigenArraysTest, TestmatrixMultiplication) {
     vectord drow1 = { 1, 2};
     vectord drow2 = { 3, 4};
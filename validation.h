@@ -0,0 +1,227 @@
+/*
+ *  validation.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nn.h"
+
+namespace math {
+    // config of the validation during training
+    typedef struct validationOptions {
+        // a snapshot of the parameters is validated every this many steps
+        size_t every = 100;
+        // stop training after this many validations without improvement (0: never stop early)
+        size_t patience = 0;
+        // a validation loss counts as improvement if it is lower than the best by more than this
+        double minImprovement = 0;
+        // after an early stop the parameters of the best snapshot are copied back into the network
+        bool restoreBest = true;
+        // threads of the validation pass
+        size_t nthreads = 1;
+        // called on the validation thread with every result (e.g. telemetry)
+        std::function<void(size_t step, const evaluation& metrics)> report;
+    } validationOptions;
+
+    /// <summary>
+    /// validation result of the snapshot taken before the given training step
+    /// </summary>
+    typedef struct validationResult {
+        size_t step;
+        evaluation metrics;
+    } validationResult;
+
+    /// <summary>
+    /// validates snapshots of a network on a background thread while it is trained. submit copies
+    /// the parameters into a spare buffer and returns, the copy is all the training thread pays.
+    /// If a snapshot is still waiting when the next one is submitted, the newer one replaces it.
+    /// </summary>
+    class validator {
+        public:
+            validator(const nn& model, const std::vector<dataSet>& _dataset, const validationOptions& _options = validationOptions())
+                : dataset(_dataset), options(_options), pool(std::max<size_t>(1, _options.nthreads)),
+                  bestParameters(model.parameters), pendingStep(0), dropped(0), busy(false), stop(false), stopped(false),
+                  bestLoss(std::numeric_limits<double>::infinity()), bestStep(0), sinceBest(0) {
+                for (int i = 0; i < 2; ++i)
+                    idle.emplace_back(new nn(model));
+                thread = std::thread([this] { work(); });
+            }
+
+            ~validator() {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    stop = true;
+                }
+                condition.notify_all();
+                thread.join();
+            }
+
+            validator(const validator&) = delete;
+            validator& operator=(const validator&) = delete;
+
+            /// <summary>
+            /// queue a snapshot of the parameters of model, taken before training step step
+            /// </summary>
+            void submit(const nn& model, size_t step) {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (pending) {
+                    ++dropped;
+                } else {
+                    pending = std::move(idle.back());
+                    idle.pop_back();
+                }
+                std::copy(model.parameters.data(), model.parameters.data() + model.ntotparameters, pending->parameters.data());
+                pendingStep = step;
+                lock.unlock();
+                condition.notify_all();
+            }
+
+            /// <summary>
+            /// block until every submitted snapshot is validated
+            /// </summary>
+            void wait() {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return !pending && !busy; });
+            }
+
+            /// <summary>
+            /// true once the validation loss did not improve for options.patience validations
+            /// </summary>
+            bool shouldStop() const {
+                return stopped.load();
+            }
+
+            /// <summary>
+            /// all results so far, in the order of their steps
+            /// </summary>
+            std::vector<validationResult> history() const {
+                std::unique_lock<std::mutex> lock(mutex);
+                return results;
+            }
+
+            /// <summary>
+            /// snapshots that were replaced by a newer one before they were validated
+            /// </summary>
+            size_t skipped() const {
+                std::unique_lock<std::mutex> lock(mutex);
+                return dropped;
+            }
+
+            /// <summary>
+            /// lowest validation loss, the step of its snapshot and the parameters of the snapshot
+            /// </summary>
+            double best() const {
+                std::unique_lock<std::mutex> lock(mutex);
+                return bestLoss;
+            }
+
+            size_t bestAt() const {
+                std::unique_lock<std::mutex> lock(mutex);
+                return bestStep;
+            }
+
+            void restore(nn& model) const {
+                std::unique_lock<std::mutex> lock(mutex);
+                std::copy(bestParameters.data(), bestParameters.data() + model.ntotparameters, model.parameters.data());
+            }
+
+            /// <summary>
+            /// train the network (gradient descent method) until the loss on the training set is
+            /// at most accuracy or the validation stops it early, only parameters with mask[i] != 0
+            /// are updated. Returns the number of steps.
+            /// </summary>
+            size_t train(nn& model, const std::vector<dataSet>& training, const double accuracy, const double learningrate, const math::vector<double>& mask) {
+                workspace ws = supervisor::createWorkspace(model);
+                const size_t every = std::max<size_t>(1, options.every);
+                size_t steps = 0;
+                double lf = 0;
+                do {
+                    if (steps % every == 0)
+                        submit(model, steps);
+                    lf = supervisor::step(model, training, learningrate, mask, ws);
+
+                    // Status
+                    if (steps++ % 100 == 0)
+                        std::cout << "lf  = " << lf << std::endl;
+                } while (lf > accuracy && !shouldStop());
+
+                if (shouldStop()) {
+                    wait();
+                    if (options.restoreBest)
+                        restore(model);
+                }
+                return steps;
+            }
+
+        private:
+            void work() {
+                for (;;) {
+                    std::unique_ptr<nn> active;
+                    size_t step;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        condition.wait(lock, [this] { return stop || pending; });
+                        if (stop)
+                            return;
+                        active = std::move(pending);
+                        step = pendingStep;
+                        busy = true;
+                    }
+
+                    const evaluation metrics = supervisor::evaluate(*active, dataset, pool);
+                    if (options.report)
+                        options.report(step, metrics);
+
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        results.push_back({ step, metrics });
+                        if (metrics.loss < bestLoss - options.minImprovement) {
+                            bestLoss = metrics.loss;
+                            bestStep = step;
+                            sinceBest = 0;
+                            std::copy(active->parameters.data(), active->parameters.data() + active->ntotparameters, bestParameters.data());
+                        } else if (options.patience > 0 && ++sinceBest >= options.patience) {
+                            stopped = true;
+                        }
+                        idle.push_back(std::move(active));
+                        busy = false;
+                    }
+                    condition.notify_all();
+                }
+            }
+
+            const std::vector<dataSet>& dataset;
+            validationOptions options;
+            threadPool pool;
+
+            /// <summary>
+            /// two snapshot buffers: each one is idle, pending or being validated
+            /// </summary>
+            std::vector<std::unique_ptr<nn>> idle;
+            std::unique_ptr<nn> pending;
+            math::vector<double> bestParameters;
+            size_t pendingStep, dropped;
+            bool busy, stop;
+            std::atomic<bool> stopped;
+
+            std::vector<validationResult> results;
+            double bestLoss;
+            size_t bestStep, sinceBest;
+
+            mutable std::mutex mutex;
+            std::condition_variable condition;
+            std::thread thread;
+    };
+}
@@ -0,0 +1,118 @@
+/*
+ *  workspace.h
+ *  Created by Matthias Kesenheimer on 18.10.26.
+ *  Copyright 2026. All rights reserved.
+ */
+
+#pragma once
+#include <vector>
+#include <Eigen/Dense>
+
+namespace math {
+    /// <summary>
+    /// scratch buffers for the forward and backward pass of one network. All buffers are
+    /// carved out of a single arena that is allocated once in the constructor, so a training
+    /// step that works on a workspace does not allocate.
+    /// A workspace must only be used by one thread at a time.
+    /// </summary>
+    typedef struct workspace {
+        workspace(size_t _ninputs, size_t _noutputs, size_t _nneurons, size_t _ntotparameters)
+            : arena(2 * (_ninputs + _nneurons + _noutputs) + _ntotparameters, 0),
+            ninputs(_ninputs), noutputs(_noutputs), nneurons(_nneurons), ntotparameters(_ntotparameters) {
+            double* p = arena.data();
+            ioutput = p; p += ninputs;
+            houtput = p; p += nneurons;
+            ooutput = p; p += noutputs;
+            idelta = p;  p += ninputs;
+            hdelta = p;  p += nneurons;
+            odelta = p;  p += noutputs;
+            gradient = p;
+        }
+
+        workspace(const workspace&) = delete;
+        workspace& operator=(const workspace&) = delete;
+        workspace(workspace&&) = default;
+
+        /// <summary>
+        /// memory backing all buffers below
+        /// </summary>
+        std::vector<double> arena;
+
+        /// <summary>
+        /// activations of the input, hidden and output layer
+        /// </summary>
+        double* ioutput;
+        double* houtput;
+        double* ooutput;
+
+        /// <summary>
+        /// derivative of the loss with respect to the net input of each layer
+        /// </summary>
+        double* idelta;
+        double* hdelta;
+        double* odelta;
+
+        /// <summary>
+        /// derivative of the loss with respect to nn.parameters
+        /// </summary>
+        double* gradient;
+
+        /// <summary>
+        /// number of inputs, outputs, neurons and parameters the workspace was sized for
+        /// </summary>
+        const size_t ninputs, noutputs, nneurons, ntotparameters;
+    } workspace;
+
+    /// <summary>
+    /// hidden activations of a dataset for training with frozen input and hidden layer
+    /// (see supervisor::cacheFrozen), one column per sample
+    /// </summary>
+    typedef struct frozenCache {
+        frozenCache()
+            : nsamples(0) {}
+
+        frozenCache(size_t noutputs, size_t nneurons, size_t _nsamples)
+            : houtput(nneurons, _nsamples), yy(noutputs, _nsamples), ooutput(noutputs, _nsamples), odelta(noutputs, _nsamples),
+            gradient(noutputs * nneurons + noutputs), nsamples(_nsamples) {}
+
+        /// <summary>
+        /// cached hidden activations and the expected outputs
+        /// </summary>
+        Eigen::MatrixXd houtput, yy;
+
+        /// <summary>
+        /// outputs and deltas of the output layer
+        /// </summary>
+        Eigen::MatrixXd ooutput, odelta;
+
+        /// <summary>
+        /// derivative of the loss with respect to oweights and otheta
+        /// </summary>
+        std::vector<double> gradient;
+
+        size_t nsamples;
+    } frozenCache;
+
+    /// <summary>
+    /// activations of the all-zero input for sparse inputs (see supervisor::prepareSparse).
+    /// An input column that is zero contributes the same to every sample, so the dense part of
+    /// the first layers is computed once per set of parameters instead of once per sample.
+    /// </summary>
+    typedef struct sparseCache {
+        sparseCache(size_t ninputs, size_t nneurons)
+            : ioutput(ninputs), hinput(nneurons), hsum(nneurons), scratch(ninputs) {}
+
+        /// <summary>
+        /// input activations of a zero input and the net input of the hidden layer it causes
+        /// (hweights * ioutput - htheta)
+        /// </summary>
+        std::vector<double> ioutput, hinput;
+
+        /// <summary>
+        /// hidden deltas summed up over the samples of a gradient, the gradient of the zero
+        /// input part is added once from them
+        /// </summary>
+        std::vector<double> hsum;
+        std::vector<double> scratch;
+    } sparseCache;
+}